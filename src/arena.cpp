@@ -0,0 +1,24 @@
+#include "arena.hpp"
+
+uint32_t SyntaxArena::allocate(size_t t_size) {
+  size_t units = (t_size + unitSize - 1) / unitSize;
+  size_t chunkUnits = chunkSize / unitSize;
+
+  // anything that doesn't fit in a normal chunk gets its own chunk
+  if (units > chunkUnits) {
+    m_chunks.push_back(std::unique_ptr<Unit[]>(new Unit[units]));
+    uint32_t id = (m_chunks.size() - 1) << offsetBits;
+    // don't bump into the oversized chunk
+    m_used = chunkUnits;
+    return id;
+  }
+
+  if (m_used + units > chunkUnits) {
+    m_chunks.push_back(std::unique_ptr<Unit[]>(new Unit[chunkUnits]));
+    m_used = 0;
+  }
+
+  uint32_t id = ((m_chunks.size() - 1) << offsetBits) | m_used;
+  m_used += units;
+  return id;
+}
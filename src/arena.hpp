@@ -0,0 +1,115 @@
+#ifndef BEAVER_ARENA_HPP
+#define BEAVER_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Handle to a node stored in a syntax tree
+// It is 32 bits wide, so it is half the size of a pointer
+// Id 0 is never used by a node, so a default handle refers to nothing
+template <typename T> class NodeRef {
+private:
+  uint32_t m_id;
+
+public:
+  constexpr NodeRef() : m_id(0) {}
+  constexpr explicit NodeRef(uint32_t t_id) : m_id(t_id) {}
+
+  constexpr uint32_t getId() const { return m_id; }
+  constexpr bool isValid() const { return m_id != 0; }
+};
+
+// Handle to a contiguous array of objects stored in a SyntaxArena
+template <typename T> class ArenaList {
+private:
+  uint32_t m_first;
+  uint32_t m_size;
+
+public:
+  constexpr ArenaList() : m_first(0), m_size(0) {}
+  constexpr ArenaList(uint32_t t_first, uint32_t t_size)
+      : m_first(t_first), m_size(t_size) {}
+
+  constexpr uint32_t getFirst() const { return m_first; }
+  constexpr uint32_t size() const { return m_size; }
+  constexpr bool empty() const { return m_size == 0; }
+};
+
+template <typename T> using NodeList = ArenaList<NodeRef<T>>;
+
+// iterable view of the elements of an ArenaList
+template <typename T> class ArenaRange {
+private:
+  const T *m_begin;
+  const T *m_end;
+
+public:
+  ArenaRange(const T *t_begin, const T *t_end)
+      : m_begin(t_begin), m_end(t_end) {}
+  const T *begin() const { return m_begin; }
+  const T *end() const { return m_end; }
+};
+
+// Bump allocator for the variable length lists of a compilation unit
+// Memory is only released when the whole arena is destroyed, and destructors
+// are never run, so only trivially copyable types can be stored
+class SyntaxArena {
+private:
+  // everything is allocated in 8 byte units
+  static constexpr size_t unitSize = 8;
+  // 64 KiB chunks, addressed by 13 bits of offset
+  static constexpr size_t offsetBits = 13;
+  static constexpr size_t chunkSize = unitSize << offsetBits;
+
+  struct alignas(unitSize) Unit {
+    std::byte bytes[unitSize];
+  };
+
+  std::vector<std::unique_ptr<Unit[]>> m_chunks;
+  // units used in the last chunk
+  size_t m_used;
+
+  // Returns the id of a new allocation of t_size bytes
+  uint32_t allocate(size_t t_size);
+
+  inline std::byte *address(uint32_t t_id) const {
+    return m_chunks[t_id >> offsetBits][t_id & ((1 << offsetBits) - 1)].bytes;
+  }
+
+public:
+  SyntaxArena() : m_used(chunkSize / unitSize) {}
+  ~SyntaxArena() = default;
+  SyntaxArena(const SyntaxArena &) = delete;
+  SyntaxArena &operator=(const SyntaxArena &) = delete;
+
+  // copy an array of trivially copyable values into the arena
+  template <typename T> ArenaList<T> makeList(const std::vector<T> &t_items) {
+    static_assert(std::is_trivially_copyable_v<T>, "lists are copied bytewise");
+    static_assert(alignof(T) <= unitSize, "unsupported alignment");
+    if (t_items.empty()) {
+      return {};
+    }
+    uint32_t id = allocate(sizeof(T) * t_items.size());
+    std::memcpy(address(id), t_items.data(), sizeof(T) * t_items.size());
+    return ArenaList<T>(id, t_items.size());
+  }
+
+  // access the elements of a list
+  template <typename T> ArenaRange<T> items(ArenaList<T> t_list) const {
+    if (t_list.empty()) {
+      return {nullptr, nullptr};
+    }
+    const T *first = reinterpret_cast<const T *>(address(t_list.getFirst()));
+    return {first, first + t_list.size()};
+  }
+  template <typename T>
+  const T &at(ArenaList<T> t_list, uint32_t t_index) const {
+    return items(t_list).begin()[t_index];
+  }
+};
+
+#endif // BEAVER_ARENA_HPP
@@ -0,0 +1,84 @@
+#ifndef BEAVER_BUILTINS_HPP
+#define BEAVER_BUILTINS_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Functions that are part of the language
+// They are called like other functions, but the type checker and the
+// lowering handle each of them separately
+enum class Builtin : uint8_t {
+  // allocate an array filled with zeros, whose type comes from the context
+  alloc,
+  // free an array made by alloc
+  free,
+  // number of elements of an array or lanes of a vector, as an i64
+  len,
+  // load(a, i) is a vector of the elements of a starting at i, whose type
+  // comes from the context
+  load,
+  // store(a, i, v) writes the lanes of v to a starting at i
+  store,
+  // shuffle(v, i...) or shuffle(v, w, i...) is a vector of the lanes i of v,
+  // or of v followed by w, and the lanes have to be literals
+  shuffle,
+  // combine the lanes of a vector
+  // floating point lanes are added in any order
+  reduceAdd,
+  reduceMin,
+  reduceMax,
+  // lane by lane for vectors, and also work on numbers
+  min,
+  max,
+  // fma(a, b, c) is a * b + c rounded once, for f64 and its vectors
+  fma,
+  // select(m, a, b) is a where m is true and b elsewhere, lane by lane if m
+  // is a mask
+  select
+};
+
+struct BuiltinInfo {
+  std::string_view name;
+  Builtin builtin;
+  uint8_t minArgs;
+  uint8_t maxArgs;
+};
+
+namespace builtins {
+constexpr std::array<BuiltinInfo, 13> BuiltinInfos = {
+    {{"alloc", Builtin::alloc, 1, 1},
+     {"free", Builtin::free, 1, 1},
+     {"len", Builtin::len, 1, 1},
+     {"load", Builtin::load, 2, 2},
+     {"store", Builtin::store, 3, 3},
+     // the sources and up to 16 lanes
+     {"shuffle", Builtin::shuffle, 2, 18},
+     {"reduceAdd", Builtin::reduceAdd, 1, 1},
+     {"reduceMin", Builtin::reduceMin, 1, 1},
+     {"reduceMax", Builtin::reduceMax, 1, 1},
+     {"min", Builtin::min, 2, 2},
+     {"max", Builtin::max, 2, 2},
+     {"fma", Builtin::fma, 3, 3},
+     {"select", Builtin::select, 3, 3}}};
+} // namespace builtins
+
+// the builtin with a name, if there is one
+inline const BuiltinInfo *getBuiltinInfo(std::string_view t_name) {
+  for (const BuiltinInfo &info : builtins::BuiltinInfos) {
+    if (info.name == t_name) {
+      return &info;
+    }
+  }
+  return nullptr;
+}
+
+inline std::optional<Builtin> getBuiltin(std::string_view t_name) {
+  if (const BuiltinInfo *info = getBuiltinInfo(t_name)) {
+    return info->builtin;
+  }
+  return {};
+}
+
+#endif // BEAVER_BUILTINS_HPP
@@ -0,0 +1,907 @@
+#include "consteval.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+// the bits of an integer that fit in t_type, sign extended
+static int64_t wrap(uint64_t t_value, ValueType t_type) {
+  if (t_type == ValueType::i32) {
+    return static_cast<int32_t>(static_cast<uint32_t>(t_value));
+  }
+  return static_cast<int64_t>(t_value);
+}
+
+static std::optional<Constant> evaluateInteger(OpCode t_op, ValueType t_type,
+                                               int64_t t_lhs, int64_t t_rhs) {
+  int64_t min = t_type == ValueType::i32 ? std::numeric_limits<int32_t>::min()
+                                         : std::numeric_limits<int64_t>::min();
+  // overflow wraps around, so it's done on unsigned numbers
+  uint64_t lhs = static_cast<uint64_t>(t_lhs);
+  uint64_t rhs = static_cast<uint64_t>(t_rhs);
+  int64_t result;
+  switch (t_op) {
+  case OpCode::add:
+    result = wrap(lhs + rhs, t_type);
+    break;
+  case OpCode::sub:
+    result = wrap(lhs - rhs, t_type);
+    break;
+  case OpCode::mult:
+    result = wrap(lhs * rhs, t_type);
+    break;
+  case OpCode::div:
+  case OpCode::mod:
+    // undefined, so it's left to happen at runtime
+    if (t_rhs == 0 || (t_lhs == min && t_rhs == -1)) {
+      return {};
+    }
+    result = t_op == OpCode::div ? t_lhs / t_rhs : t_lhs % t_rhs;
+    break;
+  default:
+    return {};
+  }
+  return Constant{t_type, result, 0};
+}
+
+// comparisons of f64s are unordered like the generated code, so every one of
+// them, == included, is true if either side is NaN
+static std::optional<bool> compareNumbers(OpCode t_op, double t_lhs,
+                                          double t_rhs) {
+  switch (t_op) {
+  case OpCode::lesser:
+    return !(t_lhs >= t_rhs);
+  case OpCode::greater:
+    return !(t_lhs <= t_rhs);
+  case OpCode::lesserEq:
+    return !(t_lhs > t_rhs);
+  case OpCode::greaterEq:
+    return !(t_lhs < t_rhs);
+  case OpCode::equalTo:
+    return !(t_lhs < t_rhs) && !(t_lhs > t_rhs);
+  case OpCode::notEqTo:
+    return !(t_lhs == t_rhs);
+  default:
+    return {};
+  }
+}
+
+static std::optional<bool> compareIntegers(OpCode t_op, int64_t t_lhs,
+                                           int64_t t_rhs) {
+  switch (t_op) {
+  case OpCode::lesser:
+    return t_lhs < t_rhs;
+  case OpCode::greater:
+    return t_lhs > t_rhs;
+  case OpCode::lesserEq:
+    return t_lhs <= t_rhs;
+  case OpCode::greaterEq:
+    return t_lhs >= t_rhs;
+  case OpCode::equalTo:
+    return t_lhs == t_rhs;
+  case OpCode::notEqTo:
+    return t_lhs != t_rhs;
+  default:
+    return {};
+  }
+}
+
+std::optional<Constant> ConstEval::evaluateBinaryOp(OpCode t_op,
+                                                    ValueType t_type,
+                                                    Constant t_lhs,
+                                                    Constant t_rhs) {
+  if (!isScalar(t_type)) {
+    return {};
+  }
+  Constant lhs = convert(t_lhs, t_type);
+  Constant rhs = convert(t_rhs, t_type);
+
+  if (t_op >= OpCode::lesser && t_op <= OpCode::notEqTo) {
+    auto result = t_type == ValueType::f64
+                      ? compareNumbers(t_op, lhs.m_number, rhs.m_number)
+                      : compareIntegers(t_op, lhs.m_integer, rhs.m_integer);
+    if (!result) {
+      return {};
+    }
+    return Constant{ValueType::boolean, *result, 0};
+  }
+
+  switch (t_type) {
+  case ValueType::f64: {
+    double result;
+    switch (t_op) {
+    case OpCode::add:
+      result = lhs.m_number + rhs.m_number;
+      break;
+    case OpCode::sub:
+      result = lhs.m_number - rhs.m_number;
+      break;
+    case OpCode::mult:
+      result = lhs.m_number * rhs.m_number;
+      break;
+    case OpCode::div:
+      result = lhs.m_number / rhs.m_number;
+      break;
+    case OpCode::mod:
+      result = std::fmod(lhs.m_number, rhs.m_number);
+      break;
+    default:
+      return {};
+    }
+    return Constant{ValueType::f64, 0, result};
+  }
+  case ValueType::i32:
+  case ValueType::i64:
+    return evaluateInteger(t_op, t_type, lhs.m_integer, rhs.m_integer);
+  default:
+    // arithmetic on bools converts them to numbers first
+    return {};
+  }
+}
+
+Constant ConstEval::convert(Constant t_value, ValueType t_type) {
+  if (t_value.m_type == t_type) {
+    return t_value;
+  }
+  // only bools are converted
+  Constant result{t_type, t_value.m_integer, 0};
+  if (t_type == ValueType::f64) {
+    result.m_number = static_cast<double>(t_value.m_integer);
+  }
+  return result;
+}
+
+bool ConstEval::isTrue(Constant t_value) {
+  if (t_value.m_type == ValueType::f64) {
+    return !std::isnan(t_value.m_number) && t_value.m_number != 0;
+  }
+  return t_value.m_integer != 0;
+}
+
+// evaluating stops after this many lines and loop iterations, so a const fn
+// that never returns can't hang the compiler
+static constexpr uint64_t maxSteps = 10000000;
+static constexpr uint32_t maxDepth = 256;
+// total length of the arrays that can exist at once
+static constexpr uint64_t maxElements = 1 << 24;
+
+static std::string quote(Symbol t_name) {
+  return "'" + std::string(symbols().getName(t_name)) + "'";
+}
+
+// the operator applied by an assignment operator
+static OpCode getUpdateOp(OpCode t_op) {
+  switch (t_op) {
+  case OpCode::plusEq:
+    return OpCode::add;
+  case OpCode::minusEq:
+    return OpCode::sub;
+  case OpCode::timesEq:
+    return OpCode::mult;
+  case OpCode::divEq:
+    return OpCode::div;
+  case OpCode::modEq:
+    return OpCode::mod;
+  default:
+    return OpCode::none;
+  }
+}
+
+ConstEval::ConstEval(const SyntaxTree &t_tree) : m_tree(t_tree) {
+  for (nodeRef item : m_tree.getItems()) {
+    const Node &node = m_tree.get(item);
+    if (node.m_kind != NodeKind::function) {
+      continue;
+    }
+    const Node &prototype = m_tree.get(node.m_operands[0]);
+    if (m_tree.hasAttribute(prototype.m_attributes, AttributeKind::constant)) {
+      m_functions.emplace(prototype.m_name, item);
+    }
+  }
+}
+
+std::nullopt_t ConstEval::fail(std::string t_error) {
+  // the first error is where evaluating stopped
+  if (m_error.empty()) {
+    m_error = std::move(t_error);
+  }
+  return std::nullopt;
+}
+
+bool ConstEval::step() {
+  if (++m_steps > maxSteps) {
+    fail("evaluating it takes more than " + std::to_string(maxSteps) +
+         " steps");
+    return false;
+  }
+  return true;
+}
+
+std::optional<Constant> ConstEval::convertTo(Constant t_value,
+                                             ValueType t_type) {
+  if (isVector(t_value.m_type) || isVector(t_type)) {
+    return fail("vectors aren't supported");
+  }
+  return convert(t_value, t_type);
+}
+
+std::optional<Constant> ConstEval::makeArray(ValueType t_type,
+                                             int64_t t_length) {
+  // like alloc, a negative length gives an empty array
+  uint64_t length = t_length < 0 ? 0 : t_length;
+  if (length > maxElements - m_elements) {
+    return fail("the arrays have more than " + std::to_string(maxElements) +
+                " elements");
+  }
+  m_elements += length;
+
+  uint32_t index = m_arrays.size();
+  if (!m_unused.empty()) {
+    index = m_unused.back();
+    m_unused.pop_back();
+  } else {
+    m_arrays.emplace_back();
+  }
+  m_arrays[index].m_elements.assign(length,
+                                    Constant{getElementType(t_type), 0, 0});
+  m_arrays[index].m_freed = false;
+  m_temporaries.push_back(index);
+  return Constant{t_type, index, 0};
+}
+
+bool ConstEval::checkNotFreed(Constant t_array) {
+  if (m_arrays[t_array.m_integer].m_freed) {
+    fail("an array is used after it's freed");
+    return false;
+  }
+  return true;
+}
+
+std::optional<Constant *> ConstEval::getElement(Constant t_array,
+                                                Constant t_index) {
+  if (!checkNotFreed(t_array)) {
+    return {};
+  }
+  std::vector<Constant> &elements = m_arrays[t_array.m_integer].m_elements;
+  if (t_index.m_integer < 0 ||
+      static_cast<uint64_t>(t_index.m_integer) >= elements.size()) {
+    return fail("an index is out of bounds");
+  }
+  return &elements[t_index.m_integer];
+}
+
+std::optional<Constant> ConstEval::evaluateBuiltin(const Node &t_node,
+                                                   Frame &t_frame) {
+  std::vector<Constant> args;
+  for (expressionRef arg : m_tree.items(t_node.m_list)) {
+    auto value = evaluateNode(arg, t_frame);
+    if (!value) {
+      return {};
+    }
+    if (isVector(value->m_type)) {
+      return fail("vectors aren't supported");
+    }
+    args.push_back(*value);
+  }
+
+  switch (*getBuiltin(symbols().getName(t_node.m_name))) {
+  case Builtin::alloc:
+    return makeArray(t_node.m_type, args[0].m_integer);
+  case Builtin::free:
+    // the elements are dropped with the other arrays after evaluating
+    if (m_arrays[args[0].m_integer].m_frozen) {
+      return fail("a constant is freed");
+    }
+    if (!checkNotFreed(args[0])) {
+      return {};
+    }
+    m_arrays[args[0].m_integer].m_freed = true;
+    return Constant{ValueType::none, 0, 0};
+  case Builtin::len:
+    if (!checkNotFreed(args[0])) {
+      return {};
+    }
+    return Constant{
+        ValueType::i64,
+        static_cast<int64_t>(m_arrays[args[0].m_integer].m_elements.size()), 0};
+  case Builtin::min:
+  case Builtin::max: {
+    Constant lhs = convert(args[0], t_node.m_type);
+    Constant rhs = convert(args[1], t_node.m_type);
+    bool min = *getBuiltin(symbols().getName(t_node.m_name)) == Builtin::min;
+    // like minnum and maxnum, NaN is only the result if both are NaN
+    if (t_node.m_type == ValueType::f64) {
+      return Constant{ValueType::f64, 0,
+                      min ? std::fmin(lhs.m_number, rhs.m_number)
+                          : std::fmax(lhs.m_number, rhs.m_number)};
+    }
+    if (isInteger(t_node.m_type)) {
+      return Constant{t_node.m_type,
+                      min ? std::min(lhs.m_integer, rhs.m_integer)
+                          : std::max(lhs.m_integer, rhs.m_integer),
+                      0};
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  return fail(quote(t_node.m_name) + " isn't supported");
+}
+
+std::optional<Constant> ConstEval::call(const Node &t_node, Frame &t_frame) {
+  auto function = m_functions.find(t_node.m_name);
+  if (function == m_functions.end()) {
+    return fail(quote(t_node.m_name) + " isn't a const fn");
+  }
+  if (m_depth >= maxDepth) {
+    return fail("calls go more than " + std::to_string(maxDepth) + " deep");
+  }
+  const Node &node = m_tree.get(function->second);
+  const Node &prototype = m_tree.get(node.m_operands[0]);
+
+  // arrays are passed by reference, like in the generated code
+  Frame callee;
+  callee.m_returnType = prototype.m_type;
+  for (uint32_t i = 0; i < t_node.m_list.size(); ++i) {
+    const Parameter &param = m_tree.at(prototype.m_params, i);
+    auto arg = evaluateNode(m_tree.at(t_node.m_list, i), t_frame);
+    if (!arg) {
+      return {};
+    }
+    auto value = convertTo(*arg, param.m_type);
+    if (!value) {
+      return {};
+    }
+    callee.m_variables[param.m_name] = *value;
+  }
+
+  ++m_depth;
+  Flow flow = runBlock(node.m_list, callee);
+  --m_depth;
+  if (flow == Flow::failed) {
+    return {};
+  }
+  if (flow == Flow::next) {
+    return fail(quote(t_node.m_name) + " ends without returning");
+  }
+  return callee.m_result;
+}
+
+std::optional<Constant> ConstEval::evaluateNode(expressionRef t_expression,
+                                                Frame &t_frame) {
+  const Node &node = m_tree.get(t_expression);
+  switch (node.m_kind) {
+  case NodeKind::number: {
+    auto value = getLiteral(node);
+    if (!value) {
+      return fail("vectors aren't supported");
+    }
+    return value;
+  }
+  case NodeKind::arrayData: {
+    // the elements of a constant that has already been evaluated
+    auto array = m_dataArrays.find(node.m_integer);
+    if (array != m_dataArrays.end()) {
+      return array->second;
+    }
+    const ArrayData &data = m_tree.getArrayData(node.m_integer);
+    bool numbers = getElementType(node.m_type) == ValueType::f64;
+    auto value = makeArray(node.m_type, numbers ? data.m_numbers.size()
+                                                : data.m_integers.size());
+    if (!value) {
+      return {};
+    }
+    std::vector<Constant> &elements = m_arrays[value->m_integer].m_elements;
+    for (size_t i = 0; i < elements.size(); ++i) {
+      if (numbers) {
+        elements[i].m_number = data.m_numbers[i];
+      } else {
+        elements[i].m_integer = data.m_integers[i];
+      }
+    }
+    freeze(*value);
+    m_dataArrays.emplace(node.m_integer, *value);
+    return value;
+  }
+  case NodeKind::variable: {
+    auto variable = t_frame.m_variables.find(node.m_name);
+    if (variable == t_frame.m_variables.end()) {
+      return fail(quote(node.m_name) + " isn't a constant");
+    }
+    return variable->second;
+  }
+  case NodeKind::binaryOp: {
+    auto lhs = evaluateNode(node.m_operands[0], t_frame);
+    if (!lhs) {
+      return {};
+    }
+    auto rhs = evaluateNode(node.m_operands[1], t_frame);
+    if (!rhs) {
+      return {};
+    }
+    if (!isScalar(node.m_type)) {
+      return fail("vectors aren't supported");
+    }
+    if (auto result = evaluateBinaryOp(node.m_op, node.m_type, *lhs, *rhs)) {
+      return result;
+    }
+    return fail("an integer is divided by 0, or the smallest integer by -1");
+  }
+  case NodeKind::assignmentOp: {
+    auto value = evaluateNode(node.m_operands[0], t_frame);
+    if (!value) {
+      return {};
+    }
+    auto variable = t_frame.m_variables.find(node.m_name);
+    if (variable == t_frame.m_variables.end()) {
+      return fail(quote(node.m_name) + " isn't a constant");
+    }
+    auto result = node.m_op == OpCode::assign
+                      ? convertTo(*value, node.m_type)
+                      : evaluateBinaryOp(getUpdateOp(node.m_op), node.m_type,
+                                         variable->second, *value);
+    if (!result) {
+      return fail("an integer is divided by 0, or the smallest integer by -1");
+    }
+    variable->second = *result;
+    return result;
+  }
+  case NodeKind::index:
+  case NodeKind::indexAssignmentOp: {
+    auto array = evaluateNode(node.m_operands[0], t_frame);
+    if (!array) {
+      return {};
+    }
+    auto index = evaluateNode(node.m_operands[1], t_frame);
+    if (!index) {
+      return {};
+    }
+    if (!isArray(array->m_type)) {
+      return fail("vectors aren't supported");
+    }
+    if (node.m_kind == NodeKind::index) {
+      auto element = getElement(*array, *index);
+      if (!element) {
+        return {};
+      }
+      return **element;
+    }
+
+    auto value = evaluateNode(node.m_operands[2], t_frame);
+    if (!value) {
+      return {};
+    }
+    if (m_arrays[array->m_integer].m_frozen) {
+      return fail("the elements of a constant are changed");
+    }
+    auto element = getElement(*array, *index);
+    if (!element) {
+      return {};
+    }
+    auto result = node.m_op == OpCode::assign
+                      ? convert(*value, node.m_type)
+                      : evaluateBinaryOp(getUpdateOp(node.m_op), node.m_type,
+                                         **element, *value);
+    if (!result) {
+      return fail("an integer is divided by 0, or the smallest integer by -1");
+    }
+    **element = *result;
+    return result;
+  }
+  case NodeKind::call:
+    if (getBuiltin(symbols().getName(node.m_name))) {
+      return evaluateBuiltin(node, t_frame);
+    }
+    return call(node, t_frame);
+  default:
+    return fail("it can't be evaluated");
+  }
+}
+
+ConstEval::Flow ConstEval::runLine(lineRef t_line, Frame &t_frame) {
+  if (!step()) {
+    return Flow::failed;
+  }
+  const Node &node = m_tree.get(t_line);
+  switch (node.m_kind) {
+  case NodeKind::conditional: {
+    for (uint32_t i = 0; i < node.m_list.size(); ++i) {
+      auto condition = evaluateNode(m_tree.at(node.m_list, i), t_frame);
+      if (!condition) {
+        return Flow::failed;
+      }
+      if (isTrue(*condition)) {
+        return runBlock(m_tree.at(node.m_blocks, i), t_frame);
+      }
+    }
+    if (node.m_blocks.size() > node.m_list.size()) {
+      return runBlock(m_tree.at(node.m_blocks, node.m_list.size()), t_frame);
+    }
+    return Flow::next;
+  }
+  case NodeKind::whileLoop:
+  case NodeKind::forLoop: {
+    bool isFor = node.m_kind == NodeKind::forLoop;
+    if (isFor) {
+      Flow flow = runLine(node.m_operands[0], t_frame);
+      if (flow != Flow::next) {
+        return flow;
+      }
+    }
+    expressionRef conditionRef = node.m_operands[isFor ? 1 : 0];
+    while (true) {
+      auto condition = evaluateNode(conditionRef, t_frame);
+      if (!condition) {
+        return Flow::failed;
+      }
+      if (!isTrue(*condition)) {
+        return Flow::next;
+      }
+      Flow flow = runBlock(node.m_list, t_frame);
+      if (flow == Flow::next && isFor) {
+        flow = runLine(node.m_operands[2], t_frame);
+      }
+      if (flow != Flow::next) {
+        return flow;
+      }
+      if (!step()) {
+        return Flow::failed;
+      }
+    }
+  }
+  case NodeKind::declaration: {
+    std::optional<Constant> value;
+    if (node.m_number) {
+      value = makeArray(node.m_type, static_cast<int64_t>(node.m_number));
+    } else if (node.m_operands[0].isValid()) {
+      value = evaluateNode(node.m_operands[0], t_frame);
+      if (value) {
+        value = convertTo(*value, node.m_type);
+      }
+    } else if (isArray(node.m_type)) {
+      value = makeArray(node.m_type, 0);
+    } else {
+      value = convertTo(Constant{node.m_type, 0, 0}, node.m_type);
+    }
+    if (!value) {
+      return Flow::failed;
+    }
+    t_frame.m_variables[node.m_name] = *value;
+    return Flow::next;
+  }
+  case NodeKind::returnLine: {
+    auto value = evaluateNode(node.m_operands[0], t_frame);
+    if (value) {
+      value = convertTo(*value, t_frame.m_returnType);
+    }
+    if (!value || (isArray(value->m_type) && !checkNotFreed(*value))) {
+      return Flow::failed;
+    }
+    t_frame.m_result = *value;
+    return Flow::returned;
+  }
+  default:
+    return evaluateNode(t_line, t_frame) ? Flow::next : Flow::failed;
+  }
+}
+
+ConstEval::Flow ConstEval::runBlock(blockRef t_block, Frame &t_frame) {
+  for (lineRef line : m_tree.items(t_block)) {
+    Flow flow = runLine(line, t_frame);
+    if (flow != Flow::next) {
+      return flow;
+    }
+  }
+  return Flow::next;
+}
+
+std::optional<Constant> ConstEval::evaluate(expressionRef t_expression,
+                                            const Variables &t_variables) {
+  // arrays from earlier evaluations that aren't constants can't be reached
+  // anymore
+  for (uint32_t index : m_temporaries) {
+    Array &array = m_arrays[index];
+    if (!array.m_frozen) {
+      m_elements -= array.m_elements.size();
+      array.m_elements = {};
+      m_unused.push_back(index);
+    }
+  }
+  m_temporaries.clear();
+  m_steps = 0;
+  m_depth = 0;
+  m_error.clear();
+
+  Frame frame;
+  frame.m_variables = t_variables;
+  return evaluateNode(t_expression, frame);
+}
+
+const std::vector<Constant> &ConstEval::freeze(Constant t_array) {
+  Array &array = m_arrays[t_array.m_integer];
+  array.m_frozen = true;
+  return array.m_elements;
+}
+
+std::optional<Constant> ConstEval::getLiteral(const Node &t_node) {
+  if (t_node.m_type == ValueType::f64) {
+    return Constant{t_node.m_type, 0, t_node.m_number};
+  }
+  if (isScalar(t_node.m_type)) {
+    return Constant{t_node.m_type, t_node.m_integer, 0};
+  }
+  return {};
+}
+
+void ConstantFolder::replace(nodeRef t_ref, Node t_node) {
+  for (uint32_t id = m_tree.get(t_ref).m_first; id < t_ref.getId(); ++id) {
+    Node &node = m_tree.get(nodeRef(id));
+    node = Node(NodeKind::removed);
+    node.m_first = id;
+  }
+  t_node.m_first = t_ref.getId();
+  m_tree.get(t_ref) = t_node;
+}
+
+void ConstantFolder::replace(nodeRef t_ref, Constant t_value) {
+  // literals stay as they are
+  if (m_tree.get(t_ref).m_kind == NodeKind::number) {
+    return;
+  }
+  Node node(NodeKind::number);
+  node.m_type = t_value.m_type;
+  node.m_integer = t_value.m_integer;
+  // m_number is kept for passes that only look at the sign of literals
+  node.m_number = t_value.m_type == ValueType::f64
+                      ? t_value.m_number
+                      : static_cast<double>(t_value.m_integer);
+  replace(t_ref, node);
+}
+
+std::optional<Constant>
+ConstantFolder::foldExpression(expressionRef t_expression) {
+  Node &node = m_tree.get(t_expression);
+  switch (node.m_kind) {
+  case NodeKind::number:
+    return ConstEval::getLiteral(node);
+  case NodeKind::variable: {
+    // constant arrays stay in their variables
+    auto variable = m_constants.find(node.m_name);
+    if (variable == m_constants.end() || !isScalar(variable->second.m_type)) {
+      return {};
+    }
+    return variable->second;
+  }
+  case NodeKind::binaryOp: {
+    // operands are only replaced once the whole operation is known not to be
+    // constant, so each node is replaced at most once
+    auto lhs = foldExpression(node.m_operands[0]);
+    auto rhs = foldExpression(node.m_operands[1]);
+    if (lhs && rhs) {
+      if (auto result =
+              ConstEval::evaluateBinaryOp(node.m_op, node.m_type, *lhs, *rhs)) {
+        return result;
+      }
+    }
+    if (lhs) {
+      replace(node.m_operands[0], *lhs);
+    }
+    if (rhs) {
+      replace(node.m_operands[1], *rhs);
+    }
+    return {};
+  }
+  default:
+    for (expressionRef operand : node.m_operands) {
+      if (operand.isValid()) {
+        foldValue(operand);
+      }
+    }
+    for (expressionRef arg : m_tree.items(node.m_list)) {
+      foldValue(arg);
+    }
+
+    // calls to const fns whose arguments are constants
+    if (node.m_kind == NodeKind::call && m_eval.isConstFunction(node.m_name)) {
+      auto value = m_eval.evaluate(t_expression, m_constants);
+      if (value && isScalar(value->m_type)) {
+        return value;
+      }
+    }
+    return {};
+  }
+}
+
+std::optional<Constant> ConstantFolder::foldValue(expressionRef t_expression) {
+  auto value = foldExpression(t_expression);
+  if (value) {
+    replace(t_expression, *value);
+  }
+  return value;
+}
+
+bool ConstantFolder::foldConstant(Node &t_node) {
+  auto value = m_eval.evaluate(t_node.m_operands[0], m_constants);
+  if (!value || isVector(t_node.m_type)) {
+    llvm::errs() << "Can't find the value of the constant '"
+                 << symbols().getName(t_node.m_name) << "' while compiling: "
+                 << (value ? "vectors aren't supported" : m_eval.getError())
+                 << ".\n";
+    return false;
+  }
+  Constant constant = ConstEval::convert(*value, t_node.m_type);
+  m_constants[t_node.m_name] = constant;
+  if (!isArray(constant.m_type)) {
+    replace(t_node.m_operands[0], constant);
+    return true;
+  }
+
+  // arrays become globals, which is why they can't be freed
+  ArrayData data;
+  for (const Constant &element : m_eval.freeze(constant)) {
+    if (element.m_type == ValueType::f64) {
+      data.m_numbers.push_back(element.m_number);
+    } else {
+      data.m_integers.push_back(element.m_integer);
+    }
+  }
+  Node array(NodeKind::arrayData);
+  array.m_type = constant.m_type;
+  array.m_integer = m_tree.addArrayData(std::move(data));
+  replace(t_node.m_operands[0], array);
+  return true;
+}
+
+void ConstantFolder::hoistDeclarations(lineRef t_line,
+                                       std::vector<lineRef> &t_hoisted) {
+  Node &node = m_tree.get(t_line);
+  switch (node.m_kind) {
+  case NodeKind::declaration:
+    // the line never runs, so the variable only has to exist
+    node.m_operands[0] = expressionRef();
+    node.m_number = 0;
+    node.m_attributes = {};
+    t_hoisted.push_back(t_line);
+    break;
+  case NodeKind::conditional:
+    for (blockRef block : m_tree.items(node.m_blocks)) {
+      for (lineRef line : m_tree.items(block)) {
+        hoistDeclarations(line, t_hoisted);
+      }
+    }
+    break;
+  case NodeKind::forLoop:
+    hoistDeclarations(node.m_operands[0], t_hoisted);
+    [[fallthrough]];
+  case NodeKind::whileLoop:
+    for (lineRef line : m_tree.items(node.m_list)) {
+      hoistDeclarations(line, t_hoisted);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+bool ConstantFolder::foldConditional(Node &t_node,
+                                     std::vector<lineRef> &t_hoisted) {
+  std::vector<expressionRef> conditions;
+  std::vector<blockRef> blocks;
+  bool hasElse = t_node.m_blocks.size() > t_node.m_list.size();
+  uint32_t i = 0;
+  for (; i < t_node.m_list.size(); ++i) {
+    expressionRef condition = m_tree.at(t_node.m_list, i);
+    auto value = foldValue(condition);
+    if (!value) {
+      conditions.push_back(condition);
+      blocks.push_back(m_tree.at(t_node.m_blocks, i));
+      continue;
+    }
+    if (!ConstEval::isTrue(*value)) {
+      for (lineRef line : m_tree.items(m_tree.at(t_node.m_blocks, i))) {
+        hoistDeclarations(line, t_hoisted);
+      }
+      continue;
+    }
+    // nothing after a condition that is always true can run, so its block
+    // becomes the else block
+    blocks.push_back(m_tree.at(t_node.m_blocks, i++));
+    for (; i < t_node.m_blocks.size(); ++i) {
+      for (lineRef line : m_tree.items(m_tree.at(t_node.m_blocks, i))) {
+        hoistDeclarations(line, t_hoisted);
+      }
+    }
+    hasElse = false;
+    break;
+  }
+  if (hasElse) {
+    blocks.push_back(m_tree.at(t_node.m_blocks, t_node.m_list.size()));
+  }
+
+  for (blockRef &block : blocks) {
+    if (!foldBlock(block)) {
+      return false;
+    }
+  }
+  t_node.m_list = m_tree.makeList(conditions);
+  t_node.m_blocks = m_tree.makeList(blocks);
+  return true;
+}
+
+bool ConstantFolder::foldLine(lineRef t_line, std::vector<lineRef> &t_hoisted) {
+  Node &node = m_tree.get(t_line);
+  switch (node.m_kind) {
+  case NodeKind::conditional:
+    return foldConditional(node, t_hoisted);
+  case NodeKind::whileLoop:
+    foldValue(node.m_operands[0]);
+    return foldBlock(node.m_list);
+  case NodeKind::forLoop:
+    if (!foldLine(node.m_operands[0], t_hoisted)) {
+      return false;
+    }
+    foldValue(node.m_operands[1]);
+    return foldLine(node.m_operands[2], t_hoisted) && foldBlock(node.m_list);
+  case NodeKind::declaration: {
+    if (m_tree.hasAttribute(node.m_attributes, AttributeKind::constant)) {
+      return foldConstant(node);
+    }
+    if (!node.m_operands[0].isValid()) {
+      return true;
+    }
+    auto value = foldValue(node.m_operands[0]);
+    if (value && isScalar(node.m_type) && !m_assigned.count(node.m_name)) {
+      m_constants[node.m_name] = ConstEval::convert(*value, node.m_type);
+    }
+    return true;
+  }
+  case NodeKind::returnLine:
+    if (node.m_operands[0].isValid()) {
+      foldValue(node.m_operands[0]);
+    }
+    return true;
+  default:
+    foldValue(t_line);
+    return true;
+  }
+}
+
+bool ConstantFolder::foldBlock(blockRef &t_block) {
+  std::vector<lineRef> lines;
+  bool hoisted = false;
+  for (lineRef line : m_tree.items(t_block)) {
+    size_t count = lines.size();
+    if (!foldLine(line, lines)) {
+      return false;
+    }
+    hoisted |= lines.size() != count;
+    lines.push_back(line);
+  }
+  if (hoisted) {
+    t_block = m_tree.makeList(lines);
+  }
+  return true;
+}
+
+bool ConstantFolder::foldFunction(nodeRef t_function) {
+  m_constants.clear();
+  m_assigned.clear();
+  Node &function = m_tree.get(t_function);
+  for (uint32_t id = function.m_first; id < t_function.getId(); ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    if (node.m_kind == NodeKind::assignmentOp) {
+      m_assigned.insert(node.m_name);
+    }
+  }
+  return foldBlock(function.m_list);
+}
+
+bool ConstantFolder::fold() {
+  for (nodeRef item : m_tree.getItems()) {
+    if (m_tree.get(item).m_kind == NodeKind::function && !foldFunction(item)) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,162 @@
+#ifndef BEAVER_CONSTEVAL_HPP
+#define BEAVER_CONSTEVAL_HPP
+
+#include "builtins.hpp"
+#include "syntaxtree.hpp"
+#include "tokens.hpp"
+#include "types.hpp"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A value known while compiling
+// integers and bools are in m_integer, and f64s in m_number
+// arrays belong to the evaluator that made them, and m_integer is their index
+struct Constant {
+  ValueType m_type = ValueType::unknown;
+  int64_t m_integer = 0;
+  double m_number = 0;
+};
+
+// Evaluates code while compiling, the same way the generated code would, so
+// using the result instead of the code never changes what a program does
+// Calls to const fns are run by an interpreter over the syntax tree
+// Anything that is undefined at runtime, like dividing an integer by 0, has no
+// value, and neither does anything that uses vectors
+class ConstEval {
+public:
+  using Variables = std::unordered_map<Symbol, Constant>;
+
+private:
+  const SyntaxTree &m_tree;
+
+  // const fns by name
+  std::unordered_map<Symbol, nodeRef> m_functions;
+
+  // arrays made while evaluating
+  // frozen arrays are the values of constants, so they can't be changed, and
+  // the rest are dropped before the next evaluation
+  // freed arrays are kept until then, so using them again can fail
+  struct Array {
+    std::vector<Constant> m_elements;
+    bool m_frozen = false;
+    bool m_freed = false;
+  };
+  std::vector<Array> m_arrays;
+  // arrays made by the current evaluation, and entries that can be reused
+  std::vector<uint32_t> m_temporaries;
+  std::vector<uint32_t> m_unused;
+  // total length of the arrays
+  uint64_t m_elements = 0;
+  // arrays for the arrayData nodes that have been evaluated
+  std::unordered_map<int64_t, Constant> m_dataArrays;
+
+  uint64_t m_steps = 0;
+  uint32_t m_depth = 0;
+  // why the last evaluation failed
+  std::string m_error;
+
+  // local variables and result of a call
+  struct Frame {
+    Variables m_variables;
+    ValueType m_returnType = ValueType::unknown;
+    Constant m_result;
+  };
+  enum class Flow { next, returned, failed };
+
+  // these set m_error when they fail
+  std::nullopt_t fail(std::string t_error);
+  // count a line or loop iteration
+  bool step();
+  std::optional<Constant> convertTo(Constant t_value, ValueType t_type);
+  std::optional<Constant> makeArray(ValueType t_type, int64_t t_length);
+  // fails if t_array has been freed
+  bool checkNotFreed(Constant t_array);
+  std::optional<Constant *> getElement(Constant t_array, Constant t_index);
+  std::optional<Constant> evaluateBuiltin(const Node &t_node, Frame &t_frame);
+  std::optional<Constant> call(const Node &t_node, Frame &t_frame);
+  std::optional<Constant> evaluateNode(expressionRef t_expression,
+                                       Frame &t_frame);
+  Flow runLine(lineRef t_line, Frame &t_frame);
+  Flow runBlock(blockRef t_block, Frame &t_frame);
+
+public:
+  ConstEval(const SyntaxTree &t_tree);
+
+  bool isConstFunction(Symbol t_name) const {
+    return m_functions.count(t_name);
+  }
+
+  // value of an expression whose variables are in t_variables, if it can be
+  // found while compiling
+  std::optional<Constant> evaluate(expressionRef t_expression,
+                                   const Variables &t_variables);
+  // why the last evaluation had no value
+  const std::string &getError() const { return m_error; }
+
+  // the elements of an array made by evaluate, which can't be changed anymore
+  const std::vector<Constant> &freeze(Constant t_array);
+
+  // the value of a number node
+  static std::optional<Constant> getLiteral(const Node &t_node);
+  // operands are converted to t_type, like binaryOp nodes do
+  static std::optional<Constant> evaluateBinaryOp(OpCode t_op, ValueType t_type,
+                                                  Constant t_lhs,
+                                                  Constant t_rhs);
+  // t_type has to be t_value's type, or a number if t_value is a bool
+  static Constant convert(Constant t_value, ValueType t_type);
+  // conditions are true if they aren't 0, and NaN is false
+  static bool isTrue(Constant t_value);
+};
+
+// Replaces constant expressions with number nodes before lowering, so less IR
+// goes into the optimizer
+// Variables declared with a constant value that are never assigned are
+// replaced by their value, calls to const fns with constant arguments are
+// evaluated, and branches of conditionals that can't be taken are removed
+// Runs after the type checker, since the value of an expression depends on its
+// type
+class ConstantFolder {
+private:
+  SyntaxTree &m_tree;
+  ConstEval m_eval;
+
+  // constant variables of the function being folded
+  ConstEval::Variables m_constants;
+  // variables that are assigned somewhere in the function
+  std::unordered_set<Symbol> m_assigned;
+
+  // replace a subtree with a single node
+  void replace(nodeRef t_ref, Node t_node);
+  // replace a subtree with a number node
+  void replace(nodeRef t_ref, Constant t_value);
+  // fold the constant parts of an expression, and return its value if the
+  // whole expression is constant, which is left for the caller to replace
+  std::optional<Constant> foldExpression(expressionRef t_expression);
+  // fold an expression, replacing all of it if it's constant
+  std::optional<Constant> foldValue(expressionRef t_expression);
+  // the value of a const declaration has to be known
+  bool foldConstant(Node &t_node);
+  // variables belong to the whole function, so the declarations in removed
+  // branches are added to t_hoisted without their values, and go before
+  // the line
+  void hoistDeclarations(lineRef t_line, std::vector<lineRef> &t_hoisted);
+  bool foldConditional(Node &t_node, std::vector<lineRef> &t_hoisted);
+  bool foldLine(lineRef t_line, std::vector<lineRef> &t_hoisted);
+  // t_block is replaced if declarations were hoisted into it
+  bool foldBlock(blockRef &t_block);
+  bool foldFunction(nodeRef t_function);
+
+public:
+  ConstantFolder(SyntaxTree &t_tree) : m_tree(t_tree), m_eval(t_tree) {}
+
+  // fold every function in the tree, returns false if the value of a
+  // constant isn't known
+  bool fold();
+};
+
+#endif // BEAVER_CONSTEVAL_HPP
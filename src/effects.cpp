@@ -0,0 +1,146 @@
+#include "effects.hpp"
+#include "builtins.hpp"
+#include "symboltable.hpp"
+
+EffectAnalysis::Effects EffectAnalysis::scan(nodeRef t_function) const {
+  Effects effects;
+  effects.m_prototype = m_tree.get(t_function).m_operands[0];
+
+  // the body is every node before the function node itself
+  for (uint32_t id = m_tree.get(t_function).m_first; id < t_function.getId();
+       ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    switch (node.m_kind) {
+    case NodeKind::index:
+    case NodeKind::indexAssignmentOp:
+      effects.m_memory = true;
+      break;
+    case NodeKind::whileLoop:
+      effects.m_loops = true;
+      break;
+    case NodeKind::forLoop:
+      // parallel loops go through the runtime
+      effects.m_loops = true;
+      effects.m_memory |=
+          m_tree.hasAttribute(node.m_attributes, AttributeKind::parallel);
+      break;
+    case NodeKind::call:
+      if (auto builtin = getBuiltin(symbols().getName(node.m_name))) {
+        switch (*builtin) {
+        case Builtin::alloc:
+        case Builtin::free:
+        case Builtin::load:
+        case Builtin::store:
+          effects.m_memory = true;
+          break;
+        default:
+          break;
+        }
+      } else {
+        effects.m_callees.push_back(node.m_name);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return effects;
+}
+
+bool EffectAnalysis::calleesHave(const Effects &t_effects,
+                                 bool Effects::*t_flag) const {
+  for (Symbol callee : t_effects.m_callees) {
+    auto function = m_functions.find(callee);
+    if (function != m_functions.end()) {
+      if (!(function->second.*t_flag)) {
+        return false;
+      }
+      continue;
+    }
+    auto declared = m_declared.find(callee);
+    if (declared == m_declared.end() || !(declared->second.*t_flag)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void EffectAnalysis::infer() {
+  for (nodeRef item : m_tree.getItems()) {
+    const Node &node = m_tree.get(item);
+    if (node.m_kind == NodeKind::function) {
+      Effects effects = scan(item);
+      m_functions.emplace(m_tree.get(effects.m_prototype).m_name,
+                          std::move(effects));
+    } else {
+      // attributes that can't be written were inferred when the module that
+      // defines the function was compiled
+      Effects effects;
+      effects.m_prototype = item;
+      effects.m_readNone =
+          m_tree.hasAttribute(node.m_attributes, AttributeKind::readNone);
+      effects.m_noUnwind =
+          m_tree.hasAttribute(node.m_attributes, AttributeKind::noUnwind);
+      effects.m_willReturn =
+          m_tree.hasAttribute(node.m_attributes, AttributeKind::willReturn);
+      m_declared.emplace(node.m_name, std::move(effects));
+    }
+  }
+
+  // externs may do anything, but beaver code never unwinds and only touches
+  // memory through arrays
+  // these start out true and are taken away until nothing changes, so
+  // functions that call each other can keep them
+  for (auto &[name, effects] : m_functions) {
+    effects.m_readNone = !effects.m_memory;
+    effects.m_noUnwind = true;
+  }
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto &[name, effects] : m_functions) {
+      if (effects.m_readNone && !calleesHave(effects, &Effects::m_readNone)) {
+        effects.m_readNone = false;
+        changed = true;
+      }
+      if (effects.m_noUnwind && !calleesHave(effects, &Effects::m_noUnwind)) {
+        effects.m_noUnwind = false;
+        changed = true;
+      }
+    }
+  }
+
+  // a function only returns once its callees do, so this one starts out false
+  // and is given out until nothing changes, and recursion never gets it
+  // arrays are left out since an index out of bounds stops the program
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto &[name, effects] : m_functions) {
+      if (!effects.m_willReturn && !effects.m_loops && !effects.m_memory &&
+          calleesHave(effects, &Effects::m_willReturn)) {
+        effects.m_willReturn = true;
+        changed = true;
+      }
+    }
+  }
+
+  for (auto &[name, effects] : m_functions) {
+    Node &prototype = m_tree.get(effects.m_prototype);
+    std::vector<Attribute> attributes;
+    for (const Attribute &attribute : m_tree.items(prototype.m_attributes)) {
+      attributes.push_back(attribute);
+    }
+    size_t written = attributes.size();
+    if (effects.m_readNone) {
+      attributes.push_back({AttributeKind::readNone, 0});
+    }
+    if (effects.m_noUnwind) {
+      attributes.push_back({AttributeKind::noUnwind, 0});
+    }
+    if (effects.m_willReturn) {
+      attributes.push_back({AttributeKind::willReturn, 0});
+    }
+    if (attributes.size() != written) {
+      prototype.m_attributes = m_tree.makeList(attributes);
+    }
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef BEAVER_EFFECTS_HPP
+#define BEAVER_EFFECTS_HPP
+
+#include "syntaxtree.hpp"
+#include <unordered_map>
+#include <vector>
+
+// Finds functions that only compute a value from their arguments, and adds
+// attributes saying so to their prototypes, so LLVM can remove unused calls to
+// them, merge repeated ones and move them out of loops
+// Runs after the constant folder, which may remove calls and array accesses
+class EffectAnalysis {
+private:
+  SyntaxTree &m_tree;
+
+  // what the body of a function does, and what is inferred from it
+  struct Effects {
+    nodeRef m_prototype;
+    // uses arrays, which either reads memory the caller can see or may stop
+    // the program on an index out of bounds
+    bool m_memory = false;
+    // has a loop, which may never end
+    bool m_loops = false;
+    // functions it calls, other than builtins
+    std::vector<Symbol> m_callees;
+
+    bool m_readNone = false;
+    bool m_noUnwind = false;
+    bool m_willReturn = false;
+  };
+  // functions defined in the tree, by name
+  std::unordered_map<Symbol, Effects> m_functions;
+  // declared functions whose effects are known, which come from the
+  // interfaces of compiled modules
+  std::unordered_map<Symbol, Effects> m_declared;
+
+  Effects scan(nodeRef t_function) const;
+  // whether every callee of t_effects is known to have t_flag
+  bool calleesHave(const Effects &t_effects, bool Effects::*t_flag) const;
+
+public:
+  EffectAnalysis(SyntaxTree &t_tree) : m_tree(t_tree) {}
+
+  // add readNone, noUnwind and willReturn to the functions they hold for
+  void infer();
+};
+
+#endif // BEAVER_EFFECTS_HPP
@@ -0,0 +1,275 @@
+#include "fingerprint.hpp"
+#include "builtins.hpp"
+#include "symboltable.hpp"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/xxhash.h"
+#include <algorithm>
+#include <type_traits>
+#include <unordered_set>
+
+// add the bytes of a value to the data that's hashed
+template <typename T>
+static void append(std::string &t_data, const T &t_value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  t_data.append(reinterpret_cast<const char *>(&t_value), sizeof(T));
+}
+
+// fields one at a time, since there's padding between them
+static void appendAttribute(std::string &t_data, const Attribute &t_attribute) {
+  append(t_data, t_attribute.m_kind);
+  append(t_data, t_attribute.m_value);
+}
+
+// names are hashed instead of symbols, which depend on the order in which
+// everything was interned
+static void appendName(std::string &t_data, Symbol t_name) {
+  std::string_view name = symbols().getName(t_name);
+  append(t_data, name.size());
+  t_data.append(name);
+}
+
+// whether m_name is used by a kind of node
+static bool hasName(NodeKind t_kind) {
+  switch (t_kind) {
+  case NodeKind::variable:
+  case NodeKind::assignmentOp:
+  case NodeKind::call:
+  case NodeKind::declaration:
+  case NodeKind::prototype:
+    return true;
+  default:
+    return false;
+  }
+}
+
+Fingerprints::Fingerprints(const SyntaxTree &t_tree) : m_tree(t_tree) {
+  for (nodeRef item : m_tree.getItems()) {
+    const Node &node = m_tree.get(item);
+    if (node.m_kind == NodeKind::function) {
+      m_signatures.emplace(m_tree.get(node.m_operands[0]).m_name,
+                           node.m_operands[0]);
+      m_functions.emplace(m_tree.get(node.m_operands[0]).m_name, item);
+    } else {
+      m_signatures.emplace(node.m_name, item);
+    }
+  }
+}
+
+void Fingerprints::hashSignature(std::string &t_data,
+                                 nodeRef t_prototype) const {
+  const Node &prototype = m_tree.get(t_prototype);
+  appendName(t_data, prototype.m_name);
+  append(t_data, prototype.m_type);
+  append(t_data, prototype.m_params.size());
+  for (const Parameter &param : m_tree.items(prototype.m_params)) {
+    appendName(t_data, param.m_name);
+    append(t_data, param.m_type);
+  }
+  append(t_data, prototype.m_attributes.size());
+  for (const Attribute &attribute : m_tree.items(prototype.m_attributes)) {
+    appendAttribute(t_data, attribute);
+  }
+}
+
+void Fingerprints::hashFunction(std::string &t_data, nodeRef t_function) const {
+  // the nodes of a function are the range ending at it, and the nodes they
+  // refer to are in the range too, so references are hashed relative to its
+  // start and the hash doesn't depend on where the function is in the file
+  uint32_t first = m_tree.get(t_function).m_first;
+  auto appendRef = [&](nodeRef t_ref) {
+    append(t_data, t_ref.isValid() ? t_ref.getId() - first : UINT32_MAX);
+  };
+
+  hashSignature(t_data, m_tree.get(t_function).m_operands[0]);
+  std::vector<Symbol> callees;
+  for (uint32_t id = first; id <= t_function.getId(); ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    append(t_data, node.m_kind);
+    append(t_data, node.m_op);
+    append(t_data, node.m_type);
+    append(t_data, node.m_first - first);
+    if (hasName(node.m_kind)) {
+      appendName(t_data, node.m_name);
+    }
+    for (nodeRef operand : node.m_operands) {
+      appendRef(operand);
+    }
+    append(t_data, node.m_list.size());
+    for (nodeRef child : m_tree.items(node.m_list)) {
+      appendRef(child);
+    }
+    append(t_data, node.m_blocks.size());
+    for (blockRef block : m_tree.items(node.m_blocks)) {
+      append(t_data, block.size());
+      for (nodeRef line : m_tree.items(block)) {
+        appendRef(line);
+      }
+    }
+    append(t_data, node.m_params.size());
+    for (const Parameter &param : m_tree.items(node.m_params)) {
+      appendName(t_data, param.m_name);
+      append(t_data, param.m_type);
+    }
+    append(t_data, node.m_attributes.size());
+    for (const Attribute &attribute : m_tree.items(node.m_attributes)) {
+      appendAttribute(t_data, attribute);
+    }
+    append(t_data, node.m_number);
+
+    // the elements of an array instead of where they're kept
+    if (node.m_kind == NodeKind::arrayData) {
+      const ArrayData &data = m_tree.getArrayData(node.m_integer);
+      append(t_data, data.m_integers.size());
+      t_data.append(reinterpret_cast<const char *>(data.m_integers.data()),
+                    data.m_integers.size() * sizeof(int64_t));
+      append(t_data, data.m_numbers.size());
+      t_data.append(reinterpret_cast<const char *>(data.m_numbers.data()),
+                    data.m_numbers.size() * sizeof(double));
+    } else {
+      append(t_data, node.m_integer);
+    }
+
+    if (node.m_kind == NodeKind::call &&
+        !getBuiltin(symbols().getName(node.m_name))) {
+      callees.push_back(node.m_name);
+    }
+  }
+
+  for (Symbol callee : callees) {
+    auto signature = m_signatures.find(callee);
+    if (signature != m_signatures.end()) {
+      hashSignature(t_data, signature->second);
+    }
+  }
+}
+
+std::vector<nodeRef> Fingerprints::getInlined(nodeRef t_function) const {
+  std::vector<nodeRef> items = {t_function};
+  std::unordered_set<uint32_t> added = {t_function.getId()};
+  // the list grows while it's walked
+  for (size_t i = 0; i < items.size(); ++i) {
+    const Node &function = m_tree.get(items[i]);
+    for (uint32_t id = function.m_first; id < items[i].getId(); ++id) {
+      const Node &node = m_tree.get(nodeRef(id));
+      if (node.m_kind != NodeKind::call) {
+        continue;
+      }
+      auto callee = m_functions.find(node.m_name);
+      if (callee == m_functions.end() ||
+          !m_tree.hasAttribute(
+              m_tree.get(m_tree.get(callee->second).m_operands[0]).m_attributes,
+              AttributeKind::alwaysInline) ||
+          !added.insert(callee->second.getId()).second) {
+        continue;
+      }
+      items.push_back(callee->second);
+    }
+  }
+  return items;
+}
+
+uint64_t Fingerprints::get(nodeRef t_function) const {
+  std::string data;
+  for (nodeRef item : getInlined(t_function)) {
+    hashFunction(data, item);
+  }
+  return llvm::xxh3_64bits(llvm::StringRef(data));
+}
+
+std::vector<Fingerprints::Chunk>
+Fingerprints::getChunks(const std::unordered_set<Symbol> &t_functions,
+                        const std::unordered_set<Symbol> &t_called) const {
+  // A module costs about as much as compiling a small function, so they're
+  // compiled a few at a time
+  // A chunk ends after a function whose name hashes to a multiple of
+  // chunkLength, so editing a function never moves the ends of other chunks,
+  // and big functions are chunks of their own
+  constexpr uint64_t chunkLength = 8;
+  constexpr uint32_t bigFunction = 2000;
+
+  std::vector<Chunk> chunks(1);
+  // the fingerprints of the functions in each chunk
+  std::vector<std::string> data(1);
+  std::unordered_map<Symbol, size_t> chunkOf;
+  // the items of the last chunk
+  std::unordered_set<uint32_t> added;
+  auto endChunk = [&]() {
+    if (!chunks.back().m_items.empty()) {
+      chunks.emplace_back();
+      data.emplace_back();
+      added.clear();
+    }
+  };
+
+  for (nodeRef item : m_tree.getItems()) {
+    const Node &node = m_tree.get(item);
+    if (node.m_kind != NodeKind::function) {
+      continue;
+    }
+    Symbol name = m_tree.get(node.m_operands[0]).m_name;
+    if (!t_functions.count(name)) {
+      continue;
+    }
+    bool big = item.getId() - node.m_first > bigFunction;
+    if (big) {
+      endChunk();
+    }
+
+    chunkOf.emplace(name, chunks.size() - 1);
+    if (t_called.count(name)) {
+      chunks.back().m_exports.insert(name);
+    }
+    append(data.back(), get(item));
+    for (nodeRef inlined : getInlined(item)) {
+      if (added.insert(inlined.getId()).second) {
+        chunks.back().m_items.push_back(inlined);
+      }
+    }
+
+    std::string_view nameText = symbols().getName(name);
+    if (big ||
+        llvm::xxh3_64bits(llvm::StringRef(nameText.data(), nameText.size())) %
+                chunkLength ==
+            0) {
+      endChunk();
+    }
+  }
+  if (chunks.back().m_items.empty()) {
+    chunks.pop_back();
+  }
+
+  // a function is exported when another chunk calls it, since everything
+  // else is removed once it's inlined, and calls to @inline functions are
+  // to the chunk's own copy
+  for (Chunk &chunk : chunks) {
+    std::unordered_set<Symbol> defined;
+    for (nodeRef item : chunk.m_items) {
+      defined.insert(m_tree.get(m_tree.get(item).m_operands[0]).m_name);
+    }
+    for (nodeRef item : chunk.m_items) {
+      for (uint32_t id = m_tree.get(item).m_first; id < item.getId(); ++id) {
+        const Node &node = m_tree.get(nodeRef(id));
+        auto callee = chunkOf.find(node.m_name);
+        if (node.m_kind == NodeKind::call && callee != chunkOf.end() &&
+            !defined.count(node.m_name)) {
+          chunks[callee->second].m_exports.insert(node.m_name);
+        }
+      }
+    }
+  }
+
+  // the exports are part of the fingerprint, since a chunk that starts
+  // calling another one can change what it has to export
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    std::vector<Symbol> exports(chunks[i].m_exports.begin(),
+                                chunks[i].m_exports.end());
+    std::sort(exports.begin(), exports.end(), [](Symbol t_a, Symbol t_b) {
+      return symbols().getName(t_a) < symbols().getName(t_b);
+    });
+    for (Symbol name : exports) {
+      appendName(data[i], name);
+    }
+    chunks[i].m_fingerprint = llvm::xxh3_64bits(llvm::StringRef(data[i]));
+  }
+  return chunks;
+}
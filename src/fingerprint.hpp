@@ -0,0 +1,59 @@
+#ifndef BEAVER_FINGERPRINT_HPP
+#define BEAVER_FINGERPRINT_HPP
+
+#include "syntaxtree.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Hashes everything that the code generated for a function depends on, so
+// functions whose fingerprints are the same as in an earlier run can use the
+// object compiled for them then
+// The nodes are hashed once they've been checked and folded, so edits that
+// don't change the folded tree, like comments, don't change it
+// The functions it calls are part of it through their signatures, except for
+// @inline ones, which are lowered into its module and hashed whole
+// Runs after the effect analysis, since callers are optimized with what it
+// finds
+class Fingerprints {
+public:
+  // Consecutive functions that are compiled into one module, along with the
+  // @inline functions they call
+  struct Chunk {
+    std::vector<nodeRef> m_items;
+    // the functions of the chunk that other chunks call
+    std::unordered_set<Symbol> m_exports;
+    // changes whenever the fingerprint of one of its functions does
+    uint64_t m_fingerprint;
+  };
+
+private:
+  const SyntaxTree &m_tree;
+
+  // prototypes of the functions that are declared or defined, by name
+  std::unordered_map<Symbol, nodeRef> m_signatures;
+  // functions defined in the tree, by name
+  std::unordered_map<Symbol, nodeRef> m_functions;
+
+  void hashSignature(std::string &t_data, nodeRef t_prototype) const;
+  // the nodes of a function and the signatures of what it calls
+  void hashFunction(std::string &t_data, nodeRef t_function) const;
+
+  // t_function, followed by the @inline functions it calls, directly or
+  // through each other
+  std::vector<nodeRef> getInlined(nodeRef t_function) const;
+  uint64_t get(nodeRef t_function) const;
+
+public:
+  Fingerprints(const SyntaxTree &t_tree);
+
+  // split the functions of the tree that are in t_functions into chunks
+  // t_called are the functions that other files call
+  std::vector<Chunk>
+  getChunks(const std::unordered_set<Symbol> &t_functions,
+            const std::unordered_set<Symbol> &t_called) const;
+};
+
+#endif // BEAVER_FINGERPRINT_HPP
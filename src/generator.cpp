@@ -2,24 +2,120 @@
 
 // Not in header, since there's lots of stuff that needs to be done in the
 // constructor
-Generator::Generator()
-    : m_context(), m_module("", m_context), m_builder(m_context),
-      m_instrumentations(m_context, true) {
+Generator::Generator(std::unique_ptr<llvm::TargetMachine> t_targetMachine,
+                     const std::string &t_name,
+                     llvm::OptimizationLevel t_optLevel, bool t_thinLTOPreLink)
+    : m_targetMachine(std::move(t_targetMachine)),
+      m_context(std::make_unique<llvm::LLVMContext>()), m_builder(*m_context),
+      m_module(std::make_unique<llvm::Module>(t_name, *m_context)),
+      m_optLevel(t_optLevel), m_instrumentations(*m_context, false),
+      m_passBuilder(m_targetMachine.get(), llvm::PipelineTuningOptions(),
+                    std::nullopt, &m_callbacks) {
+  // the name is also the source file name, which ThinLTO needs to tell
+  // modules apart
+  m_module->setSourceFileName(t_name);
+  m_module->setDataLayout(m_targetMachine->createDataLayout());
+  m_module->setTargetTriple(m_targetMachine->getTargetTriple().str());
+
   m_instrumentations.registerCallbacks(m_callbacks, &m_moduleAnalyzer);
 
-  m_funcPass.addPass(llvm::InstCombinePass());
-  m_funcPass.addPass(llvm::ReassociatePass());
-  m_funcPass.addPass(llvm::GVNPass());
-  m_funcPass.addPass(llvm::SimplifyCFGPass());
-
-  llvm::PassBuilder passBuilder;
-  passBuilder.registerModuleAnalyses(m_moduleAnalyzer);
-  passBuilder.registerCGSCCAnalyses(m_callAnalyzer);
-  passBuilder.registerFunctionAnalyses(m_funcAnalyzer);
-  passBuilder.registerLoopAnalyses(m_loopAnalyzer);
-  passBuilder.crossRegisterProxies(m_loopAnalyzer, m_funcAnalyzer,
-                                   m_callAnalyzer, m_moduleAnalyzer);
-
-  m_optimizer =
-      passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
-}
\ No newline at end of file
+  // variables live in allocas until they're promoted to registers, which is
+  // cheap enough to do even at O0
+  m_funcPass.addPass(llvm::PromotePass());
+  if (m_optLevel != llvm::OptimizationLevel::O0) {
+    m_funcPass.addPass(llvm::InstCombinePass());
+    m_funcPass.addPass(llvm::ReassociatePass());
+    m_funcPass.addPass(llvm::GVNPass());
+    m_funcPass.addPass(llvm::SimplifyCFGPass());
+  }
+
+  m_passBuilder.registerModuleAnalyses(m_moduleAnalyzer);
+  m_passBuilder.registerCGSCCAnalyses(m_callAnalyzer);
+  m_passBuilder.registerFunctionAnalyses(m_funcAnalyzer);
+  m_passBuilder.registerLoopAnalyses(m_loopAnalyzer);
+  m_passBuilder.crossRegisterProxies(m_loopAnalyzer, m_funcAnalyzer,
+                                     m_callAnalyzer, m_moduleAnalyzer);
+
+  if (t_thinLTOPreLink) {
+    m_optimizer = m_passBuilder.buildThinLTOPreLinkDefaultPipeline(m_optLevel);
+  } else if (m_optLevel == llvm::OptimizationLevel::O0) {
+    m_optimizer = m_passBuilder.buildO0DefaultPipeline(m_optLevel);
+  } else {
+    m_optimizer = m_passBuilder.buildPerModuleDefaultPipeline(m_optLevel);
+  }
+}
+
+void Generator::addTargetAttributes(llvm::Function &t_function) {
+  t_function.addFnAttr("target-cpu", m_targetMachine->getTargetCPU());
+  if (!m_targetMachine->getTargetFeatureString().empty()) {
+    t_function.addFnAttr("target-features",
+                         m_targetMachine->getTargetFeatureString());
+  }
+}
+
+void Generator::optimize() { m_optimizer.run(*m_module, m_moduleAnalyzer); }
+
+bool Generator::addEntryPoint(const std::string &t_name) {
+  llvm::Function *beaverMain = m_module->getFunction("main");
+  if (!beaverMain || beaverMain->empty()) {
+    llvm::errs() << "No main function found.\n";
+    return false;
+  }
+  if (!beaverMain->arg_empty()) {
+    llvm::errs() << "main can't take any arguments.\n";
+    return false;
+  }
+  llvm::Type *returnType = beaverMain->getReturnType();
+  if (!returnType->isIntegerTy() && !returnType->isFloatingPointTy()) {
+    llvm::errs() << "main has to return a number or a bool.\n";
+    return false;
+  }
+
+  // the C main takes its name, so it can be inlined into it
+  if (t_name == "main") {
+    beaverMain->setName("beaver.main");
+    beaverMain->setLinkage(llvm::Function::InternalLinkage);
+  }
+
+  llvm::Function *entryPoint = llvm::Function::Create(
+      llvm::FunctionType::get(m_builder.getInt32Ty(), false),
+      llvm::Function::ExternalLinkage, t_name, m_module.get());
+  addTargetAttributes(*entryPoint);
+  llvm::FunctionCallee printFunction = m_module->getOrInsertFunction(
+      "printf", llvm::FunctionType::get(m_builder.getInt32Ty(),
+                                        {m_builder.getPtrTy()}, true));
+
+  // int main() { printf("%g\n", beaver.main()); return 0; }
+  // with the format for the type main returns
+  m_builder.SetInsertPoint(
+      llvm::BasicBlock::Create(*m_context, "", entryPoint));
+  llvm::Value *result = m_builder.CreateCall(beaverMain);
+  llvm::Type *type = result->getType();
+  const char *format = "%g\n";
+  if (type->isIntegerTy(1)) {
+    format = "%s\n";
+    result =
+        m_builder.CreateSelect(result, m_builder.CreateGlobalStringPtr("true"),
+                               m_builder.CreateGlobalStringPtr("false"));
+  } else if (type->isIntegerTy(32)) {
+    format = "%d\n";
+  } else if (type->isIntegerTy(64)) {
+    format = "%lld\n";
+  }
+  m_builder.CreateCall(printFunction,
+                       {m_builder.CreateGlobalStringPtr(format), result});
+  m_builder.CreateRet(m_builder.getInt32(0));
+
+  return !llvm::verifyFunction(*entryPoint, &llvm::errs());
+}
+
+llvm::orc::ThreadSafeModule Generator::takeModule() {
+  // cached analyses would outlive the IR they describe
+  m_loopAnalyzer.clear();
+  m_funcAnalyzer.clear();
+  m_callAnalyzer.clear();
+  m_moduleAnalyzer.clear();
+  m_builder.ClearInsertionPoint();
+
+  return llvm::orc::ThreadSafeModule(std::move(m_module), std::move(m_context));
+}
@@ -1,32 +1,42 @@
 #ifndef BEAVER_GENERATOR_HPP
 #define BEAVER_GENERATOR_HPP
 
+#include "symboltable.hpp"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Passes/OptimizationLevel.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/StandardInstrumentations.h"
+#include "llvm/Target/TargetMachine.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "llvm/Transforms/Scalar/Reassociate.h"
 #include "llvm/Transforms/Scalar/SimplifyCFG.h"
-#include <map>
+#include "llvm/Transforms/Utils/Mem2Reg.h"
 #include <memory>
+#include <unordered_map>
 
 // Generator class
 // Everything related to creating the module is in this class, including
 // optimizations
 struct Generator {
   // stuff for generation
-  llvm::LLVMContext m_context;
+  // target machines can't be shared between threads, so every generator
+  // has its own
+  std::unique_ptr<llvm::TargetMachine> m_targetMachine;
+  // the context and module are handed over to the JIT once they're finished
+  std::unique_ptr<llvm::LLVMContext> m_context;
   llvm::IRBuilder<> m_builder;
-  llvm::Module m_module;
-  std::map<std::string, llvm::AllocaInst *> m_namedValues;
+  std::unique_ptr<llvm::Module> m_module;
+  std::unordered_map<Symbol, llvm::AllocaInst *> m_namedValues;
 
   // stuff for optimization
+  llvm::OptimizationLevel m_optLevel;
   llvm::FunctionPassManager m_funcPass;
   llvm::LoopAnalysisManager m_loopAnalyzer;
   llvm::FunctionAnalysisManager m_funcAnalyzer;
@@ -34,10 +44,35 @@ struct Generator {
   llvm::ModuleAnalysisManager m_moduleAnalyzer;
   llvm::PassInstrumentationCallbacks m_callbacks;
   llvm::StandardInstrumentations m_instrumentations;
+  // the analyses registered by the pass builder refer to it, so it has to
+  // live as long as the analysis managers
+  llvm::PassBuilder m_passBuilder;
 
   llvm::ModulePassManager m_optimizer;
 
-  Generator();
+  // t_thinLTOPreLink selects the pipeline for bitcode that will be
+  // optimized again when it is linked
+  // the module is named t_name and gets the target's data layout and triple
+  Generator(std::unique_ptr<llvm::TargetMachine> t_targetMachine,
+            const std::string &t_name, llvm::OptimizationLevel t_optLevel,
+            bool t_thinLTOPreLink = false);
+
+  // Keep the cpu and features of the target machine with a function, so
+  // bitcode that's linked later is still compiled for them
+  void addTargetAttributes(llvm::Function &t_function);
+
+  // run the module pipeline once the whole module has been generated
+  void optimize();
+
+  // Add a C entry point named t_name that prints the result of main
+  // Programs compiled ahead of time call it "main", and Beaver's main is
+  // renamed to make room for it
+  // returns false if there is no main function
+  bool addEntryPoint(const std::string &t_name = "main");
+
+  // Give up ownership of the module and its context
+  // Nothing can be generated afterwards
+  llvm::orc::ThreadSafeModule takeModule();
 };
 
 #endif // BEAVER_GENERATOR_HPP
\ No newline at end of file
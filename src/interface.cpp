@@ -0,0 +1,203 @@
+#include "interface.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+// An interface file starts with this line, followed by a line per import and
+// per function:
+//   import name
+//   fn name returnType [param type]... [@attribute]...
+// the version changes whenever the format does, so old files are rejected
+static constexpr std::string_view interfaceFormat = "beaver-interface 2";
+
+// the attributes that are kept, by their name in interface files
+// const isn't one of them, since an importer can't evaluate a module's
+// const fns
+static constexpr std::pair<std::string_view, AttributeKind> attributeNames[] = {
+    {"cold", AttributeKind::cold},
+    {"readnone", AttributeKind::readNone},
+    {"nounwind", AttributeKind::noUnwind},
+    {"willreturn", AttributeKind::willReturn}};
+
+static std::string_view toView(llvm::StringRef t_string) {
+  return std::string_view(t_string.data(), t_string.size());
+}
+
+// getTypeName in reverse
+static std::optional<ValueType> typeFromName(std::string_view t_name) {
+  if (t_name == "none") {
+    return ValueType::none;
+  }
+  for (size_t i = 0; i < types::ArrayNames.size(); ++i) {
+    if (types::ArrayNames[i] == t_name) {
+      return types::ArrayTypes[i].second;
+    }
+  }
+  return getTypeFromName(t_name);
+}
+
+// add what a line says to t_interface, returns false if it's malformed
+static bool readLine(ModuleInterface &t_interface,
+                     llvm::ArrayRef<llvm::StringRef> t_fields) {
+  if (t_fields.size() == 2 && t_fields[0] == "import") {
+    t_interface.m_imports.push_back(symbols().intern(toView(t_fields[1])));
+    return true;
+  }
+  if (t_fields.size() < 3 || t_fields[0] != "fn") {
+    return false;
+  }
+  auto returnType = typeFromName(toView(t_fields[2]));
+  if (!returnType) {
+    return false;
+  }
+  ModuleInterface::Function function{
+      symbols().intern(toView(t_fields[1])), {}, *returnType, {}};
+
+  size_t i = 3;
+  for (; i < t_fields.size() && t_fields[i].front() != '@'; i += 2) {
+    if (i + 1 == t_fields.size()) {
+      return false;
+    }
+    auto type = typeFromName(toView(t_fields[i + 1]));
+    if (!type) {
+      return false;
+    }
+    function.m_params.push_back({symbols().intern(toView(t_fields[i])), *type});
+  }
+  for (; i < t_fields.size(); ++i) {
+    std::string_view name = toView(t_fields[i].drop_front());
+    const auto *attribute =
+        std::find_if(std::begin(attributeNames), std::end(attributeNames),
+                     [&](auto &t_entry) { return t_entry.first == name; });
+    if (attribute == std::end(attributeNames)) {
+      return false;
+    }
+    function.m_attributes.push_back({attribute->second, 0});
+  }
+  t_interface.m_functions.push_back(std::move(function));
+  return true;
+}
+
+void ModuleInterface::addFunctions(const SyntaxTree &t_tree) {
+  for (nodeRef item : t_tree.getItems()) {
+    const Node &node = t_tree.get(item);
+    if (node.m_kind != NodeKind::function) {
+      continue;
+    }
+    const Node &prototype = t_tree.get(node.m_operands[0]);
+    Function function{prototype.m_name, {}, prototype.m_type, {}};
+    for (const Parameter &param : t_tree.items(prototype.m_params)) {
+      function.m_params.push_back(param);
+    }
+    for (const Attribute &attribute : t_tree.items(prototype.m_attributes)) {
+      for (auto &[name, kind] : attributeNames) {
+        if (attribute.m_kind == kind) {
+          function.m_attributes.push_back({kind, 0});
+        }
+      }
+    }
+    m_functions.push_back(std::move(function));
+  }
+}
+
+bool ModuleInterface::declare(SyntaxTree &t_tree,
+                              std::string_view t_module) const {
+  std::unordered_map<Symbol, NodeKind> declared;
+  for (nodeRef item : t_tree.getItems()) {
+    const Node &node = t_tree.get(item);
+    Symbol name = node.m_kind == NodeKind::function
+                      ? t_tree.get(node.m_operands[0]).m_name
+                      : node.m_name;
+    declared.emplace(name, node.m_kind);
+  }
+
+  for (const Function &function : m_functions) {
+    auto [found, inserted] =
+        declared.emplace(function.m_name, NodeKind::prototype);
+    if (!inserted) {
+      if (found->second == NodeKind::function) {
+        llvm::errs() << "The function '" << symbols().getName(function.m_name)
+                     << "' is also defined by the module '" << t_module
+                     << "'.\n";
+        return false;
+      }
+      continue;
+    }
+    t_tree.addItem(t_tree.addPrototype(
+        function.m_name, t_tree.makeList(function.m_params),
+        function.m_returnType, t_tree.makeList(function.m_attributes)));
+  }
+  return true;
+}
+
+bool ModuleInterface::write(const std::string &t_path) const {
+  std::error_code errorCode;
+  llvm::raw_fd_ostream stream(t_path, errorCode, llvm::sys::fs::OF_Text);
+  if (errorCode) {
+    llvm::errs() << "Could not open file: " << errorCode.message() << '\n';
+    return false;
+  }
+
+  stream << interfaceFormat << '\n';
+  for (Symbol module : m_imports) {
+    stream << "import " << symbols().getName(module) << '\n';
+  }
+  for (const Function &function : m_functions) {
+    stream << "fn " << symbols().getName(function.m_name) << ' '
+           << getTypeName(function.m_returnType);
+    for (const Parameter &param : function.m_params) {
+      stream << ' ' << symbols().getName(param.m_name) << ' '
+             << getTypeName(param.m_type);
+    }
+    for (const Attribute &attribute : function.m_attributes) {
+      for (auto &[name, kind] : attributeNames) {
+        if (attribute.m_kind == kind) {
+          stream << " @" << name;
+        }
+      }
+    }
+    stream << '\n';
+  }
+
+  stream.close();
+  if (stream.has_error()) {
+    llvm::errs() << "Could not write " << t_path << ": "
+                 << stream.error().message() << '\n';
+    stream.clear_error();
+    return false;
+  }
+  return true;
+}
+
+std::optional<ModuleInterface>
+ModuleInterface::read(const std::string &t_path) {
+  auto buffer = llvm::MemoryBuffer::getFile(t_path, true);
+  if (!buffer) {
+    llvm::errs() << "Could not open file: " << t_path << '\n';
+    return {};
+  }
+
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  (*buffer)->getBuffer().split(lines, '\n', -1, false);
+  if (lines.empty() || toView(lines[0].rtrim('\r')) != interfaceFormat) {
+    llvm::errs() << t_path << " wasn't written by this version of beaver.\n";
+    return {};
+  }
+
+  ModuleInterface result;
+  for (size_t i = 1; i < lines.size(); ++i) {
+    llvm::SmallVector<llvm::StringRef, 16> fields;
+    lines[i].rtrim('\r').split(fields, ' ', -1, false);
+    if (!readLine(result, fields)) {
+      llvm::errs() << "Malformed line " << i + 1 << " in " << t_path << ".\n";
+      return {};
+    }
+  }
+  return result;
+}
@@ -0,0 +1,39 @@
+#ifndef BEAVER_INTERFACE_HPP
+#define BEAVER_INTERFACE_HPP
+
+#include "symboltable.hpp"
+#include "syntaxtree.hpp"
+#include "types.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What a program that imports a compiled module needs to know about it: the
+// prototypes of its functions and the modules it imports itself
+// It's written next to the module's bitcode as a .bvi file, so importing a
+// module reads a line per function instead of parsing and checking its source
+struct ModuleInterface {
+  struct Function {
+    Symbol m_name;
+    std::vector<Parameter> m_params;
+    ValueType m_returnType;
+    // only the ones that matter to callers
+    std::vector<Attribute> m_attributes;
+  };
+  std::vector<Symbol> m_imports;
+  std::vector<Function> m_functions;
+
+  // add the functions defined in t_tree, after the effect analysis has run
+  void addFunctions(const SyntaxTree &t_tree);
+
+  // declare the functions in t_tree as if it had declared them with extern
+  // returns false if t_tree defines one of them itself
+  bool declare(SyntaxTree &t_tree, std::string_view t_module) const;
+
+  // these report why they failed
+  bool write(const std::string &t_path) const;
+  static std::optional<ModuleInterface> read(const std::string &t_path);
+};
+
+#endif // BEAVER_INTERFACE_HPP
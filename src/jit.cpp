@@ -0,0 +1,116 @@
+#include "jit.hpp"
+
+// build either kind of JIT
+template <typename Builder>
+static llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>>
+build(llvm::orc::JITTargetMachineBuilder t_machineBuilder,
+      unsigned t_compileThreads, llvm::ObjectCache *t_cache) {
+  Builder builder;
+  builder.setJITTargetMachineBuilder(std::move(t_machineBuilder))
+      .setNumCompileThreads(t_compileThreads);
+
+  // the compiler checks the cache before compiling a module and stores the
+  // object afterwards
+  if (t_cache) {
+    builder.setCompileFunctionCreator(
+        [t_cache](llvm::orc::JITTargetMachineBuilder t_machineBuilder)
+            -> llvm::Expected<
+                std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+          return std::make_unique<llvm::orc::ConcurrentIRCompiler>(
+              std::move(t_machineBuilder), t_cache);
+        });
+  }
+  auto jit = builder.create();
+  if (!jit) {
+    return jit.takeError();
+  }
+  return std::move(*jit);
+}
+
+std::optional<JIT>
+JIT::create(const std::string &t_triple, const std::string &t_cpu,
+            const std::string &t_features, llvm::CodeGenOptLevel t_codeGenLevel,
+            unsigned t_compileThreads, llvm::ObjectCache *t_cache) {
+  llvm::orc::JITTargetMachineBuilder machineBuilder((llvm::Triple(t_triple)));
+  machineBuilder.setCPU(t_cpu);
+  machineBuilder.getFeatures() = llvm::SubtargetFeatures(t_features);
+  machineBuilder.setCodeGenOptLevel(t_codeGenLevel);
+
+  // 0 compile threads means compiling on the thread that needs the code
+  // the lazy JIT splits modules up, so its objects can't be cached
+  bool lazy = t_compileThreads <= 1 && !t_cache;
+  unsigned threads = t_compileThreads > 1 ? t_compileThreads : 0;
+  auto jit =
+      lazy ? build<llvm::orc::LLLazyJITBuilder>(machineBuilder, 0, nullptr)
+           : build<llvm::orc::LLJITBuilder>(machineBuilder, threads, t_cache);
+  if (!jit) {
+    llvm::errs() << llvm::toString(jit.takeError()) << '\n';
+    return {};
+  }
+
+  // anything that isn't defined in beaver, like the C library, comes from the
+  // process itself
+  // the compiler's own main is hidden, so it can't stand in for a missing
+  // beaver main
+  llvm::orc::SymbolStringPtr hostMain = (*jit)->mangleAndIntern("main");
+  auto processSymbols =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          (*jit)->getDataLayout().getGlobalPrefix(),
+          [hostMain](const llvm::orc::SymbolStringPtr &t_symbol) {
+            return t_symbol != hostMain;
+          });
+  if (!processSymbols) {
+    llvm::errs() << llvm::toString(processSymbols.takeError()) << '\n';
+    return {};
+  }
+  (*jit)->getMainJITDylib().addGenerator(std::move(*processSymbols));
+
+  // the runtime is part of the compiler
+  llvm::orc::SymbolMap runtime;
+  runtime[(*jit)->mangleAndIntern("beaver_parallel_for")] =
+      llvm::orc::ExecutorSymbolDef(
+          llvm::orc::ExecutorAddr::fromPtr(&beaver_parallel_for),
+          llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+  if (llvm::Error error = (*jit)->getMainJITDylib().define(
+          llvm::orc::absoluteSymbols(std::move(runtime)))) {
+    llvm::errs() << llvm::toString(std::move(error)) << '\n';
+    return {};
+  }
+
+  // compile one function at a time instead of the whole module
+  if (lazy) {
+    static_cast<llvm::orc::LLLazyJIT &>(**jit).setPartitionFunction(
+        llvm::orc::CompileOnDemandLayer::compileRequested);
+  }
+
+  return JIT(std::move(*jit), lazy);
+}
+
+bool JIT::addModule(llvm::orc::ThreadSafeModule t_module) {
+  llvm::Error error =
+      m_lazy ? static_cast<llvm::orc::LLLazyJIT &>(*m_jit).addLazyIRModule(
+                   std::move(t_module))
+             : m_jit->addIRModule(std::move(t_module));
+  if (error) {
+    llvm::errs() << llvm::toString(std::move(error)) << '\n';
+    return false;
+  }
+  return true;
+}
+
+bool JIT::addObject(std::unique_ptr<llvm::MemoryBuffer> t_object) {
+  if (llvm::Error error = m_jit->addObjectFile(std::move(t_object))) {
+    llvm::errs() << llvm::toString(std::move(error)) << '\n';
+    return false;
+  }
+  return true;
+}
+
+std::optional<void *> JIT::lookup(const std::string &t_name) {
+  auto symbol = m_jit->lookup(t_name);
+  if (!symbol) {
+    llvm::consumeError(symbol.takeError());
+    return {};
+  }
+  return symbol->toPtr<void *>();
+}
@@ -0,0 +1,53 @@
+#ifndef BEAVER_JIT_HPP
+#define BEAVER_JIT_HPP
+
+#include "runtime.hpp"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/AbsoluteSymbols.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <optional>
+#include <string>
+
+// Runs generated modules in this process
+// With a single compile thread, calls go through stubs and a function is
+// only compiled the first time it is called, so code that never runs is
+// never compiled
+// With more threads, whole modules are compiled concurrently on a thread
+// pool as soon as main needs them
+// With an object cache, whole modules are compiled so that their objects
+// can be stored and loaded again
+class JIT {
+private:
+  std::unique_ptr<llvm::orc::LLJIT> m_jit;
+  // set when m_jit is an LLLazyJIT
+  bool m_lazy;
+
+public:
+  JIT(std::unique_ptr<llvm::orc::LLJIT> t_jit, bool t_lazy)
+      : m_jit(std::move(t_jit)), m_lazy(t_lazy) {}
+
+  // returns nothing if there is no JIT for the target
+  static std::optional<JIT>
+  create(const std::string &t_triple, const std::string &t_cpu,
+         const std::string &t_features, llvm::CodeGenOptLevel t_codeGenLevel,
+         unsigned t_compileThreads, llvm::ObjectCache *t_cache = nullptr);
+
+  // returns false if the module couldn't be added
+  bool addModule(llvm::orc::ThreadSafeModule t_module);
+  // add an object that was compiled earlier
+  bool addObject(std::unique_ptr<llvm::MemoryBuffer> t_object);
+
+  // address of a function, or nothing if it doesn't exist
+  std::optional<void *> lookup(const std::string &t_name);
+};
+
+#endif // BEAVER_JIT_HPP
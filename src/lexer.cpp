@@ -1,36 +1,46 @@
 #include "lexer.hpp"
+#include "scanner.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-Token getTokFromKey(std::string t_key) {
-  auto lookup = lexer::TokenKeys.find(t_key);
-  if (lookup == lexer::TokenKeys.end()) {
-    return Token::identifier;
-  }
-  return lookup->second;
+void Lexer::setSource(std::string_view t_source) {
+  m_begin = t_source.data();
+  m_cursor = m_begin;
+  m_end = m_begin + t_source.size();
+  m_currChar = m_cursor != m_end ? *m_cursor : EOF;
+}
+
+unsigned Lexer::getLine(uint32_t t_offset) const {
+  return 1 + std::count(m_begin, m_begin + t_offset, '\n');
 }
 
-char Lexer::nextChar() {
-  m_lastChar = m_currChar;
-  m_currChar = processChar();
-  if (m_currChar == '\n') {
-    ++m_lineNumber;
-    m_charPos = 0;
-  } else {
-    ++m_charPos;
+unsigned Lexer::getPos(uint32_t t_offset) const {
+  const char *position = m_begin + t_offset;
+  const char *lineStart = position;
+  while (lineStart != m_begin && lineStart[-1] != '\n') {
+    --lineStart;
   }
-  return m_currChar;
+  return 1 + (position - lineStart);
 }
 
 // Kind of a band-aid function, will probably be replaced later
 // Returns whether a character is a valid operation character
 bool isOperation(char t_character) {
-  if (std::isalnum(t_character)) {
+  if (t_character == EOF) {
+    return false;
+  }
+  if (scanner::isAlnum(t_character)) {
     return false;
   }
-  if (std::isspace(t_character)) {
+  if (scanner::isSpace(t_character)) {
     return false;
   }
-  static const char invalid[8] = {'(', ')', '{', '}', '[', ']', ';', ','};
-  for (int idx = 0; idx < 8; ++idx) {
+  static const char invalid[9] = {'(', ')', '{', '}', '[', ']', ';', ',', '@'};
+  for (int idx = 0; idx < 9; ++idx) {
     if (t_character == invalid[idx]) {
       return false;
     }
@@ -40,59 +50,142 @@ bool isOperation(char t_character) {
 
 Token Lexer::processToken() {
   // ignore whitespace
-  while (std::isspace(m_currChar)) {
-    nextChar();
+  if (scanner::isSpace(m_currChar)) {
+    skipTo(scanner::skipWhitespace(m_cursor, m_end));
   }
+  m_tokenStart = m_cursor;
 
   // Keywords and identifiers
-  if (std::isalpha(m_currChar)) {
-    m_identifier = m_currChar;
+  if (scanner::isAlpha(m_currChar)) {
+    const char *start = m_cursor;
     // [A-z]([A-z]|[1-9])*
-    while (std::isalnum(nextChar())) {
-      m_identifier += m_currChar;
-    }
+    skipTo(scanner::skipIdentifier(m_cursor + 1, m_end));
+    m_identifier = std::string_view(start, m_cursor - start);
 
     return getTokFromKey(m_identifier);
   }
 
   // Numbers
-  if (std::isdigit(m_currChar) || m_currChar == '.') {
-    std::string numStr;
+  if (scanner::isDigit(m_currChar) || m_currChar == '.') {
+    const char *start = m_cursor;
     do {
-      numStr += m_currChar;
       nextChar();
-    } while (std::isdigit(m_currChar) || m_currChar == '.');
+    } while (scanner::isDigit(m_currChar) || m_currChar == '.');
 
-    m_numVal = std::stoi(numStr);
+    // numbers are short enough that this doesn't allocate
+    m_numVal = std::stod(std::string(start, m_cursor - start));
     return Token::number;
   }
 
   // Comments
   if (m_currChar == '#') {
-    do {
-      nextChar();
-    } while (m_currChar != EOF && m_currChar != '\n' && m_currChar != '\r');
+    skipTo(scanner::findLineEnd(m_cursor + 1, m_end));
 
     if (m_currChar != EOF) {
-      return nextToken();
+      return processToken();
     }
   }
 
   if (m_currChar == EOF) {
+    m_tokenStart = m_cursor;
     return Token::endFile;
   }
 
   // Operations
   if (!isOperation(m_currChar)) {
-    m_operation = "";
+    m_operation = {};
     nextChar();
     return Token::unknown;
   }
-  m_operation = m_currChar;
+  const char *start = m_cursor;
   while (isOperation(nextChar())) {
-    m_operation += m_currChar;
   }
+  m_operation = std::string_view(start, m_cursor - start);
+  m_opCode = getOpFromKey(m_operation);
+
+  return Token::operation;
+}
+
+MappedFileLexer::MappedFileLexer(const std::string &t_fileName)
+    : Lexer(), m_mapping(nullptr), m_size(0), m_valid(false) {
+  int fileDescriptor = open(t_fileName.c_str(), O_RDONLY);
+  if (fileDescriptor < 0) {
+    setSource({});
+    return;
+  }
+
+  struct stat fileInfo;
+  if (fstat(fileDescriptor, &fileInfo) < 0) {
+    close(fileDescriptor);
+    setSource({});
+    return;
+  }
+  m_size = fileInfo.st_size;
+
+  // mmap doesn't accept empty mappings
+  if (m_size == 0) {
+    close(fileDescriptor);
+    m_valid = true;
+    setSource({});
+    return;
+  }
+
+  void *mapping =
+      mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fileDescriptor);
+  if (mapping == MAP_FAILED) {
+    m_size = 0;
+    setSource({});
+    return;
+  }
+
+  // the file is scanned front to back exactly once
+  madvise(mapping, m_size, MADV_SEQUENTIAL);
+
+  m_mapping = mapping;
+  m_valid = true;
+  setSource(std::string_view(static_cast<const char *>(m_mapping), m_size));
+}
+
+MappedFileLexer::~MappedFileLexer() {
+  if (m_mapping) {
+    munmap(m_mapping, m_size);
+  }
+}
+
+TokenBuffer Lexer::tokenize() {
+  TokenBuffer result;
+  // a rough guess, to avoid most of the reallocations
+  result.reserve((m_end - m_cursor) / 4 + 1);
+
+  Token token;
+  do {
+    token = nextToken();
+    SourceSpan span = {static_cast<uint32_t>(m_tokenStart - m_begin),
+                       static_cast<uint32_t>(m_cursor - m_tokenStart)};
+    switch (token) {
+    case Token::identifier:
+      result.push(token, symbols().intern(m_identifier), span);
+      break;
+    case Token::number:
+      result.pushNumber(m_numVal, span);
+      break;
+    case Token::operation:
+      result.push(token, static_cast<uint32_t>(m_opCode), span);
+      break;
+    case Token::unknown:
+      result.push(token, static_cast<unsigned char>(m_lastChar), span);
+      break;
+    default:
+      result.push(token, 0, span);
+      break;
+    }
+  } while (token != Token::endFile);
+
+  return result;
+}
 
-  // If all else fails, return unknown
-  return Token::unknown;
-}
\ No newline at end of file
+StdinLexer::StdinLexer()
+    : BufferLexer(std::string(std::istreambuf_iterator<char>(std::cin),
+                              std::istreambuf_iterator<char>())) {}
@@ -1,59 +1,93 @@
 #ifndef BEAVER_LEXER_HPP
 #define BEAVER_LEXER_HPP
 
-#include <cctype>
-#include <fstream>
+#include "perfecthash.hpp"
+#include "tokens.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
-
-// Class for all special tokens
-enum class Token {
-  unknown,
-  endFile,
-  func,
-  externTok,
-  identifier,
-  number,
-  ifTok,
-  elifTok,
-  elseTok,
-  returnTok,
-  whileTok,
-  forTok,
-  letTok
-};
+#include <string_view>
 
 namespace lexer {
 // conversion from strings to tokens
-const std::map<std::string, Token> TokenKeys = {
-    {"fn", Token::func},        {"extern", Token::externTok},
-    {"if", Token::ifTok},       {"elif", Token::elifTok},
-    {"else", Token::elseTok},   {"ret", Token::returnTok},
-    {"while", Token::whileTok}, {"for", Token::forTok},
-    {"let", Token::letTok}};
+constexpr std::array<std::pair<std::string_view, Token>, 14> TokenKeyList = {
+    {{"fn", Token::func},
+     {"extern", Token::externTok},
+     {"import", Token::importTok},
+     {"if", Token::ifTok},
+     {"elif", Token::elifTok},
+     {"else", Token::elseTok},
+     {"ret", Token::returnTok},
+     {"while", Token::whileTok},
+     {"for", Token::forTok},
+     {"pfor", Token::pforTok},
+     {"let", Token::letTok},
+     {"const", Token::constTok},
+     {"true", Token::trueTok},
+     {"false", Token::falseTok}}};
+
+// conversion from strings to operators
+constexpr std::array<std::pair<std::string_view, OpCode>, 19> OpKeyList = {
+    {{"+", OpCode::add},
+     {"-", OpCode::sub},
+     {"*", OpCode::mult},
+     {"/", OpCode::div},
+     {"%", OpCode::mod},
+     {"<", OpCode::lesser},
+     {">", OpCode::greater},
+     {"<=", OpCode::lesserEq},
+     {">=", OpCode::greaterEq},
+     {"==", OpCode::equalTo},
+     {"!=", OpCode::notEqTo},
+     {"=", OpCode::assign},
+     {"+=", OpCode::plusEq},
+     {"-=", OpCode::minusEq},
+     {"*=", OpCode::timesEq},
+     {"/=", OpCode::divEq},
+     {"%=", OpCode::modEq},
+     {":", OpCode::colon},
+     {"->", OpCode::arrow}}};
+
+constexpr PerfectHash TokenKeys(TokenKeyList);
+static_assert(TokenKeys.isValid(), "no perfect hash for the keywords");
+
+constexpr PerfectHash OpKeys(OpKeyList);
+static_assert(OpKeys.isValid(), "no perfect hash for the operators");
 } // namespace lexer
 
 // returns the token if one is found, and Token::identifier otherwise
-Token getTokFromKey(std::string t_key);
-
-// Responsible for reading the file and parsing into tokens
+inline Token getTokFromKey(std::string_view t_key) {
+  return lexer::TokenKeys.find(t_key).value_or(Token::identifier);
+}
+
+// returns the operator if one is found, and OpCode::none otherwise
+inline OpCode getOpFromKey(std::string_view t_key) {
+  return lexer::OpKeys.find(t_key).value_or(OpCode::none);
+}
+
+// Responsible for scanning a source buffer and splitting it into tokens
+// The buffer itself is supplied by the derived classes, and the whole source
+// must be in memory, so scanning is just pointer arithmetic
 class Lexer {
-protected:
-  // for error handling
-  // Note: currently somewhat buggy
-  unsigned m_lineNumber;
-  unsigned m_charPos;
+private:
+  // source buffer
+  // m_cursor is the position of m_currChar, or m_end once the buffer has been
+  // fully read
+  const char *m_begin;
+  const char *m_cursor;
+  const char *m_end;
 
-  // Read the next character
-  // Implementation specified in derived class
-  virtual char processChar() = 0;
+  // start of the most recent token
+  const char *m_tokenStart;
 
-private:
   // stored processed values
-  std::string m_identifier;
+  // these are slices of the source buffer, so they are only valid as long as
+  // the lexer is
+  std::string_view m_identifier;
   double m_numVal;
-  std::string m_operation;
+  std::string_view m_operation;
+  OpCode m_opCode;
 
   // Character information
   Token m_currTok;
@@ -61,57 +95,117 @@ private:
   char m_lastChar;
 
   // gives the lexer the next character, updates variables
-  char nextChar();
+  inline char nextChar() {
+    m_lastChar = m_currChar;
+    if (m_cursor != m_end) {
+      ++m_cursor;
+    }
+    m_currChar = m_cursor != m_end ? *m_cursor : EOF;
+    return m_currChar;
+  }
+
+  // moves to a position found by one of the bulk scanning functions, as if
+  // nextChar() had been called until reaching it
+  inline void skipTo(const char *t_position) {
+    if (t_position == m_cursor) {
+      return;
+    }
+    m_lastChar = t_position[-1];
+    m_cursor = t_position;
+    m_currChar = m_cursor != m_end ? *m_cursor : EOF;
+  }
 
   // Does the actual processing for tokens
   Token processToken();
 
+protected:
+  // Set the buffer to be scanned
+  // Derived classes must call this once the source is available
+  void setSource(std::string_view t_source);
+
 public:
   Lexer()
-      : m_identifier(""), m_numVal(0), m_operation(""),
-        m_currTok(Token::unknown), m_currChar(' '), m_lastChar(' '),
-        m_lineNumber(1), m_charPos(1) {}
+      : m_begin(nullptr), m_cursor(nullptr), m_end(nullptr),
+        m_tokenStart(nullptr), m_numVal(0), m_opCode(OpCode::none),
+        m_currTok(Token::unknown), m_currChar(EOF), m_lastChar(' ') {}
   virtual ~Lexer() = default;
 
+  // the lexer hands out views into its buffer, so it can't be copied
+  Lexer(const Lexer &) = delete;
+  Lexer &operator=(const Lexer &) = delete;
+
   // Functions to get stored information
 
-  inline std::string getIdentifier() const { return m_identifier; }
+  inline std::string_view getIdentifier() const { return m_identifier; }
   inline double getNum() const { return m_numVal; }
-  inline std::string getOperation() const { return m_operation; }
+  inline std::string_view getOperation() const { return m_operation; }
+  // the operator of the current token, or OpCode::none if it isn't one
+  inline OpCode getOpCode() const {
+    return m_currTok == Token::operation ? m_opCode : OpCode::none;
+  }
   inline Token getTok() const { return m_currTok; }
   inline char getChar() const { return m_lastChar; }
 
   // Line and position functions
+  // These are only needed for diagnostics, so they are computed on demand
+  // from an offset into the source instead of being tracked for every
+  // character
+
+  unsigned getLine(uint32_t t_offset) const;
+  unsigned getPos(uint32_t t_offset) const;
+
+  // the text of a token
+  inline std::string_view getText(SourceSpan t_span) const {
+    return std::string_view(m_begin + t_span.offset, t_span.length);
+  }
 
-  inline unsigned getLine() const { return m_lineNumber; }
-  inline unsigned getPos() const { return m_charPos; }
+  // the whole source
+  inline std::string_view getSource() const {
+    return std::string_view(m_begin, m_end - m_begin);
+  }
 
   // Process the next token
   inline Token nextToken() { return m_currTok = processToken(); }
+
+  // Lex the rest of the source into a token buffer
+  // The buffer always ends with Token::endFile
+  TokenBuffer tokenize();
 };
 
-// For reading from files
-class FileLexer : public Lexer {
+// Lexes a source that is already in memory
+class BufferLexer : public Lexer {
 private:
-  std::ifstream m_fileStream;
+  std::string m_source;
 
-protected:
-  inline char processChar() override { return m_fileStream.get(); }
+public:
+  BufferLexer(std::string t_source) : Lexer(), m_source(std::move(t_source)) {
+    setSource(m_source);
+  }
+  ~BufferLexer() = default;
+};
+
+// For reading from files
+// The file is mapped into memory instead of being read character by character
+class MappedFileLexer : public Lexer {
+private:
+  void *m_mapping;
+  size_t m_size;
+  bool m_valid;
 
 public:
-  FileLexer(std::string t_fileName) : Lexer(), m_fileStream(t_fileName) {}
-  ~FileLexer() = default;
+  MappedFileLexer(const std::string &t_fileName);
+  ~MappedFileLexer();
+
+  // whether the file could be opened and mapped
+  inline bool isValid() const { return m_valid; }
 };
 
 // Read from stdin
 // Currently not used
-class StdinLexer : public Lexer {
-protected:
-  inline char processChar() override { return getchar(); }
-
+class StdinLexer : public BufferLexer {
 public:
-  StdinLexer() : Lexer() {}
+  StdinLexer();
   ~StdinLexer() = default;
 };
 
-#endif // BEAVER_LEXER_HPP
\ No newline at end of file
+#endif // BEAVER_LEXER_HPP
@@ -0,0 +1,1347 @@
+#include "lowering.hpp"
+
+Lowering::Lowering(Generator &t_gen, const SyntaxTree &t_tree,
+                   const std::unordered_set<Symbol> *t_exports)
+    : m_gen(t_gen), m_tree(t_tree), m_exports(t_exports) {
+  for (nodeRef item : m_tree.getItems()) {
+    const Node &node = m_tree.get(item);
+    nodeRef prototype =
+        node.m_kind == NodeKind::function ? node.m_operands[0] : item;
+    m_signatures.emplace(m_tree.get(prototype).m_name, prototype);
+  }
+}
+
+llvm::Type *Lowering::lowerType(ValueType t_type) {
+  switch (t_type) {
+  case ValueType::boolean:
+    return m_gen.m_builder.getInt1Ty();
+  case ValueType::i32:
+    return m_gen.m_builder.getInt32Ty();
+  case ValueType::i64:
+    return m_gen.m_builder.getInt64Ty();
+  case ValueType::none:
+    return m_gen.m_builder.getVoidTy();
+  default:
+    break;
+  }
+  if (isVector(t_type)) {
+    return llvm::FixedVectorType::get(lowerType(getLaneType(t_type)),
+                                      getLaneCount(t_type));
+  }
+  // arrays are a pointer to the first element and the number of elements
+  if (isArray(t_type)) {
+    return llvm::StructType::get(
+        *m_gen.m_context,
+        {m_gen.m_builder.getPtrTy(), m_gen.m_builder.getInt64Ty()});
+  }
+  return m_gen.m_builder.getDoubleTy();
+}
+
+llvm::Value *Lowering::convert(llvm::Value *t_value, llvm::Type *t_type) {
+  if (t_value->getType() == t_type) {
+    return t_value;
+  }
+  // values are put in every lane of a vector
+  auto *vectorType = llvm::dyn_cast<llvm::FixedVectorType>(t_type);
+  if (vectorType && !t_value->getType()->isVectorTy()) {
+    return m_gen.m_builder.CreateVectorSplat(
+        vectorType->getNumElements(),
+        convert(t_value, vectorType->getElementType()));
+  }
+  // only booleans are converted, to 0 or 1
+  if (!t_value->getType()->isIntegerTy(1)) {
+    return t_value;
+  }
+  if (t_type->isFloatingPointTy()) {
+    return m_gen.m_builder.CreateUIToFP(t_value, t_type);
+  }
+  return m_gen.m_builder.CreateZExt(t_value, t_type);
+}
+
+llvm::AllocaInst *Lowering::createVariable(llvm::Type *t_type, Symbol t_name) {
+  return createVariable(t_type, symbols().getName(t_name));
+}
+
+llvm::AllocaInst *Lowering::createVariable(llvm::Type *t_type,
+                                           const llvm::Twine &t_name) {
+  llvm::BasicBlock &entry =
+      m_gen.m_builder.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> builder(&entry, entry.begin());
+  return builder.CreateAlloca(t_type, nullptr, t_name);
+}
+
+llvm::BasicBlock *Lowering::getBoundsError() {
+  if (m_boundsError) {
+    return m_boundsError;
+  }
+
+  // write(2, "Index out of bounds.\n", 21); exit(1);
+  llvm::IRBuilderBase::InsertPointGuard guard(m_gen.m_builder);
+  m_boundsError = llvm::BasicBlock::Create(
+      *m_gen.m_context, "", m_gen.m_builder.GetInsertBlock()->getParent());
+  m_gen.m_builder.SetInsertPoint(m_boundsError);
+
+  llvm::Type *sizeType =
+      m_gen.m_module->getDataLayout().getIntPtrType(*m_gen.m_context);
+  llvm::FunctionCallee writeFunction = m_gen.m_module->getOrInsertFunction(
+      "write", llvm::FunctionType::get(sizeType,
+                                       {m_gen.m_builder.getInt32Ty(),
+                                        m_gen.m_builder.getPtrTy(), sizeType},
+                                       false));
+  llvm::FunctionCallee exitFunction = m_gen.m_module->getOrInsertFunction(
+      "exit", llvm::FunctionType::get(m_gen.m_builder.getVoidTy(),
+                                      {m_gen.m_builder.getInt32Ty()}, false));
+
+  llvm::StringRef message = "Index out of bounds.\n";
+  m_gen.m_builder.CreateCall(
+      writeFunction, {m_gen.m_builder.getInt32(2),
+                      m_gen.m_builder.CreateGlobalStringPtr(message),
+                      llvm::ConstantInt::get(sizeType, message.size())});
+  m_gen.m_builder.CreateCall(exitFunction, {m_gen.m_builder.getInt32(1)})
+      ->setDoesNotReturn();
+  m_gen.m_builder.CreateUnreachable();
+  return m_boundsError;
+}
+
+void Lowering::checkBounds(llvm::Value *t_inBounds) {
+  llvm::BasicBlock *inBoundsBB = llvm::BasicBlock::Create(
+      *m_gen.m_context, "", m_gen.m_builder.GetInsertBlock()->getParent());
+  m_gen.m_builder.CreateCondBr(
+      t_inBounds, inBoundsBB, getBoundsError(),
+      llvm::MDBuilder(*m_gen.m_context).createBranchWeights(1 << 20, 1));
+  m_gen.m_builder.SetInsertPoint(inBoundsBB);
+}
+
+llvm::Value *Lowering::lowerIndex(const Node &t_node, llvm::Value *t_index,
+                                  llvm::Value *t_length) {
+  llvm::Value *index =
+      m_gen.m_builder.CreateSExt(t_index, m_gen.m_builder.getInt64Ty());
+
+  // a[i] inside a loop that keeps i in bounds of a
+  const Node &arrayNode = m_tree.get(t_node.m_operands[0]);
+  const Node &indexNode = m_tree.get(t_node.m_operands[1]);
+  bool safe = arrayNode.m_kind == NodeKind::variable &&
+              indexNode.m_kind == NodeKind::variable &&
+              std::find(m_safeIndices.begin(), m_safeIndices.end(),
+                        std::pair(indexNode.m_name, arrayNode.m_name)) !=
+                  m_safeIndices.end();
+
+  // negative indices are too big as unsigned numbers, so one comparison
+  // checks both ends
+  if (!safe) {
+    checkBounds(m_gen.m_builder.CreateICmpULT(index, t_length));
+  }
+  return index;
+}
+
+llvm::Value *Lowering::lowerElementPointer(const Node &t_node,
+                                           llvm::Value *t_array,
+                                           llvm::Value *t_index) {
+  llvm::Value *index = lowerIndex(
+      t_node, t_index, m_gen.m_builder.CreateExtractValue(t_array, 1));
+  llvm::Value *elements = m_gen.m_builder.CreateExtractValue(t_array, 0);
+  return m_gen.m_builder.CreateInBoundsGEP(lowerType(t_node.m_type), elements,
+                                           index);
+}
+
+llvm::Value *Lowering::lowerLanesPointer(llvm::Value *t_array,
+                                         llvm::Value *t_index,
+                                         llvm::FixedVectorType *t_type) {
+  llvm::Value *index =
+      m_gen.m_builder.CreateSExt(t_index, m_gen.m_builder.getInt64Ty());
+  llvm::Value *length = m_gen.m_builder.CreateExtractValue(t_array, 1);
+
+  // the first comparison rules out negative indices, and the end can only
+  // overflow if the start is already out of bounds
+  llvm::Value *end = m_gen.m_builder.CreateAdd(
+      index, m_gen.m_builder.getInt64(t_type->getNumElements()));
+  checkBounds(
+      m_gen.m_builder.CreateAnd(m_gen.m_builder.CreateICmpULT(index, length),
+                                m_gen.m_builder.CreateICmpULE(end, length)));
+
+  llvm::Value *elements = m_gen.m_builder.CreateExtractValue(t_array, 0);
+  return m_gen.m_builder.CreateInBoundsGEP(t_type->getElementType(), elements,
+                                           index);
+}
+
+llvm::Value *Lowering::lowerBuiltin(const Node &t_node, Builtin t_builtin) {
+  size_t numArgs = t_node.m_list.size();
+  std::vector<llvm::Value *> args(m_values.end() - numArgs, m_values.end());
+  m_values.resize(m_values.size() - numArgs);
+  llvm::Type *type = lowerType(t_node.m_type);
+  const llvm::DataLayout &dataLayout = m_gen.m_module->getDataLayout();
+
+  switch (t_builtin) {
+  case Builtin::alloc: {
+    // calloc(n, size), and an empty array if that fails or n is negative
+    llvm::Type *elementType = lowerType(getElementType(t_node.m_type));
+    llvm::FunctionCallee callocFunction = m_gen.m_module->getOrInsertFunction(
+        "calloc", llvm::FunctionType::get(m_gen.m_builder.getPtrTy(),
+                                          {m_gen.m_builder.getInt64Ty(),
+                                           m_gen.m_builder.getInt64Ty()},
+                                          false));
+    llvm::Value *elements = m_gen.m_builder.CreateCall(
+        callocFunction,
+        {args[0],
+         m_gen.m_builder.getInt64(dataLayout.getTypeAllocSize(elementType))});
+    llvm::Value *failed = m_gen.m_builder.CreateOr(
+        m_gen.m_builder.CreateIsNull(elements),
+        m_gen.m_builder.CreateICmpSLT(args[0], m_gen.m_builder.getInt64(0)));
+    llvm::Value *length = m_gen.m_builder.CreateSelect(
+        failed, m_gen.m_builder.getInt64(0), args[0]);
+
+    llvm::Value *array = llvm::UndefValue::get(type);
+    array = m_gen.m_builder.CreateInsertValue(array, elements, 0);
+    return m_gen.m_builder.CreateInsertValue(array, length, 1);
+  }
+  case Builtin::free: {
+    llvm::FunctionCallee freeFunction = m_gen.m_module->getOrInsertFunction(
+        "free", llvm::FunctionType::get(m_gen.m_builder.getVoidTy(),
+                                        {m_gen.m_builder.getPtrTy()}, false));
+    return m_gen.m_builder.CreateCall(
+        freeFunction, {m_gen.m_builder.CreateExtractValue(args[0], 0)});
+  }
+  case Builtin::len:
+    if (auto *vectorType =
+            llvm::dyn_cast<llvm::FixedVectorType>(args[0]->getType())) {
+      return m_gen.m_builder.getInt64(vectorType->getNumElements());
+    }
+    return m_gen.m_builder.CreateExtractValue(args[0], 1);
+  case Builtin::load: {
+    auto *vectorType = llvm::cast<llvm::FixedVectorType>(type);
+    llvm::Value *lanes = lowerLanesPointer(args[0], args[1], vectorType);
+    return m_gen.m_builder.CreateAlignedLoad(
+        vectorType, lanes,
+        dataLayout.getABITypeAlign(vectorType->getElementType()));
+  }
+  case Builtin::store: {
+    auto *vectorType = llvm::cast<llvm::FixedVectorType>(args[2]->getType());
+    llvm::Value *lanes = lowerLanesPointer(args[0], args[1], vectorType);
+    return m_gen.m_builder.CreateAlignedStore(
+        args[2], lanes,
+        dataLayout.getABITypeAlign(vectorType->getElementType()));
+  }
+  case Builtin::shuffle: {
+    // the lanes are literals, so they're read from the tree
+    size_t sources = args[1]->getType()->isVectorTy() ? 2 : 1;
+    std::vector<int> mask;
+    for (size_t i = sources; i < numArgs; ++i) {
+      mask.push_back(
+          static_cast<int>(m_tree.get(m_tree.at(t_node.m_list, i)).m_integer));
+    }
+    llvm::Value *second =
+        sources == 2 ? args[1] : llvm::PoisonValue::get(args[0]->getType());
+    return m_gen.m_builder.CreateShuffleVector(args[0], second, mask);
+  }
+  case Builtin::reduceAdd:
+    if (type->isFloatingPointTy()) {
+      // reassociation turns the reduction into a tree instead of a chain
+      auto *reduction =
+          llvm::cast<llvm::Instruction>(m_gen.m_builder.CreateFAddReduce(
+              llvm::ConstantFP::getNegativeZero(type), args[0]));
+      reduction->setHasAllowReassoc(true);
+      return reduction;
+    }
+    return m_gen.m_builder.CreateAddReduce(args[0]);
+  case Builtin::reduceMin:
+    if (type->isFloatingPointTy()) {
+      return m_gen.m_builder.CreateFPMinReduce(args[0]);
+    }
+    return m_gen.m_builder.CreateIntMinReduce(args[0], true);
+  case Builtin::reduceMax:
+    if (type->isFloatingPointTy()) {
+      return m_gen.m_builder.CreateFPMaxReduce(args[0]);
+    }
+    return m_gen.m_builder.CreateIntMaxReduce(args[0], true);
+  case Builtin::min:
+  case Builtin::max: {
+    llvm::Value *lhs = convert(args[0], type);
+    llvm::Value *rhs = convert(args[1], type);
+    bool isMin = t_builtin == Builtin::min;
+    if (type->isFPOrFPVectorTy()) {
+      return isMin ? m_gen.m_builder.CreateMinNum(lhs, rhs)
+                   : m_gen.m_builder.CreateMaxNum(lhs, rhs);
+    }
+    return m_gen.m_builder.CreateBinaryIntrinsic(
+        isMin ? llvm::Intrinsic::smin : llvm::Intrinsic::smax, lhs, rhs);
+  }
+  case Builtin::fma:
+    return m_gen.m_builder.CreateIntrinsic(llvm::Intrinsic::fma, {type},
+                                           {convert(args[0], type),
+                                            convert(args[1], type),
+                                            convert(args[2], type)});
+  case Builtin::select:
+    return m_gen.m_builder.CreateSelect(args[0], convert(args[1], type),
+                                        convert(args[2], type));
+  }
+  return nullptr;
+}
+
+llvm::Constant *Lowering::lowerArrayData(const Node &t_node) {
+  const ArrayData &data = m_tree.getArrayData(t_node.m_integer);
+  llvm::Constant *elements;
+  uint64_t length;
+  switch (getElementType(t_node.m_type)) {
+  case ValueType::i32: {
+    std::vector<int32_t> values(data.m_integers.begin(), data.m_integers.end());
+    elements = llvm::ConstantDataArray::get(*m_gen.m_context, values);
+    length = values.size();
+    break;
+  }
+  case ValueType::i64:
+    elements = llvm::ConstantDataArray::get(
+        *m_gen.m_context, llvm::ArrayRef<int64_t>(data.m_integers));
+    length = data.m_integers.size();
+    break;
+  default:
+    elements = llvm::ConstantDataArray::get(
+        *m_gen.m_context, llvm::ArrayRef<double>(data.m_numbers));
+    length = data.m_numbers.size();
+    break;
+  }
+
+  // writable, since copies of the array and the functions it's passed to can
+  // change its elements, and LLVM still folds loads from it when nothing does
+  auto *global =
+      new llvm::GlobalVariable(*m_gen.m_module, elements->getType(), false,
+                               llvm::GlobalValue::PrivateLinkage, elements);
+  global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  auto *type = llvm::cast<llvm::StructType>(lowerType(t_node.m_type));
+  return llvm::ConstantStruct::get(type,
+                                   {global, m_gen.m_builder.getInt64(length)});
+}
+
+bool Lowering::lowerExpressionNode(const Node &t_node) {
+  switch (t_node.m_kind) {
+  case NodeKind::number: {
+    llvm::Type *type = lowerType(t_node.m_type);
+    if (type->isFloatingPointTy()) {
+      m_values.push_back(llvm::ConstantFP::get(type, t_node.m_number));
+    } else {
+      m_values.push_back(llvm::ConstantInt::get(type, t_node.m_integer, true));
+    }
+    return true;
+  }
+  case NodeKind::arrayData:
+    m_values.push_back(lowerArrayData(t_node));
+    return true;
+  case NodeKind::removed:
+    return true;
+  case NodeKind::variable: {
+    // search in named variables
+    llvm::AllocaInst *variable = m_gen.m_namedValues[t_node.m_name];
+    if (!variable) {
+      llvm::errs() << "Unknown variable name.\n";
+      return false;
+    }
+    m_values.push_back(
+        m_gen.m_builder.CreateLoad(variable->getAllocatedType(), variable));
+    return true;
+  }
+  case NodeKind::index: {
+    llvm::Value *index = m_values.back();
+    m_values.pop_back();
+
+    // lanes of vectors
+    if (auto *vectorType =
+            llvm::dyn_cast<llvm::FixedVectorType>(m_values.back()->getType())) {
+      llvm::Value *lanes =
+          m_gen.m_builder.getInt64(vectorType->getNumElements());
+      index = lowerIndex(t_node, index, lanes);
+      m_values.back() =
+          m_gen.m_builder.CreateExtractElement(m_values.back(), index);
+      return true;
+    }
+
+    llvm::Value *element = lowerElementPointer(t_node, m_values.back(), index);
+    m_values.back() =
+        m_gen.m_builder.CreateLoad(lowerType(t_node.m_type), element);
+    return true;
+  }
+  case NodeKind::binaryOp: {
+    llvm::Type *type = lowerType(t_node.m_type);
+    llvm::Value *rightCode = convert(m_values.back(), type);
+    m_values.pop_back();
+    llvm::Value *leftCode = convert(m_values.back(), type);
+    m_values.back() =
+        getBinOp(t_node.m_op)->codegen(m_gen, leftCode, rightCode);
+    return true;
+  }
+  case NodeKind::assignmentOp: {
+    auto leftCode = m_gen.m_namedValues[t_node.m_name];
+    if (!leftCode) {
+      return false;
+    }
+    llvm::Value *value = convert(m_values.back(), leftCode->getAllocatedType());
+    m_values.back() =
+        getAssignmentOp(t_node.m_op)->codegen(m_gen, leftCode, value);
+    return true;
+  }
+  case NodeKind::indexAssignmentOp: {
+    llvm::Value *value = convert(m_values.back(), lowerType(t_node.m_type));
+    m_values.pop_back();
+    llvm::Value *index = m_values.back();
+    m_values.pop_back();
+
+    // lanes are written in the variable that holds the vector
+    llvm::Value *element;
+    if (auto *vectorType =
+            llvm::dyn_cast<llvm::FixedVectorType>(m_values.back()->getType())) {
+      llvm::Value *lanes =
+          m_gen.m_builder.getInt64(vectorType->getNumElements());
+      index = lowerIndex(t_node, index, lanes);
+      llvm::AllocaInst *variable =
+          m_gen.m_namedValues[m_tree.get(t_node.m_operands[0]).m_name];
+      element = m_gen.m_builder.CreateInBoundsGEP(
+          vectorType, variable, {m_gen.m_builder.getInt64(0), index});
+    } else {
+      element = lowerElementPointer(t_node, m_values.back(), index);
+    }
+    m_values.back() =
+        getAssignmentOp(t_node.m_op)->codegen(m_gen, element, value);
+    return true;
+  }
+  case NodeKind::call: {
+    if (auto builtin = getBuiltin(symbols().getName(t_node.m_name))) {
+      m_values.push_back(lowerBuiltin(t_node, *builtin));
+      return true;
+    }
+
+    // search for the function being called
+    llvm::Function *calledFunction =
+        m_gen.m_module->getFunction(symbols().getName(t_node.m_name));
+    if (!calledFunction) {
+      auto signature = m_signatures.find(t_node.m_name);
+      if (signature == m_signatures.end()) {
+        std::cerr << "Unknown function\n";
+        return false;
+      }
+      // defined later or somewhere else
+      calledFunction = *lowerPrototype(m_tree.get(signature->second));
+    }
+
+    // the arguments are the last values, in order, and arrays are passed as
+    // their elements and length
+    size_t numArgs = t_node.m_list.size();
+    std::vector<llvm::Value *> argsCode;
+    for (auto arg = m_values.end() - numArgs; arg != m_values.end(); ++arg) {
+      if ((*arg)->getType()->isStructTy()) {
+        argsCode.push_back(m_gen.m_builder.CreateExtractValue(*arg, 0));
+        argsCode.push_back(m_gen.m_builder.CreateExtractValue(*arg, 1));
+      } else {
+        argsCode.push_back(*arg);
+      }
+    }
+    m_values.resize(m_values.size() - numArgs);
+
+    // check for number of arguments
+    if (calledFunction->arg_size() != argsCode.size()) {
+      std::cerr << "Incorrect number of arguments\n";
+      return false;
+    }
+    for (size_t i = 0; i < argsCode.size(); ++i) {
+      argsCode[i] = convert(argsCode[i], calledFunction->getArg(i)->getType());
+    }
+    m_values.push_back(m_gen.m_builder.CreateCall(calledFunction, argsCode));
+    return true;
+  }
+  default:
+    llvm::errs() << "Unexpected statement in expression.\n";
+    return false;
+  }
+}
+
+std::optional<llvm::Value *>
+Lowering::lowerExpression(expressionRef t_expression) {
+  // the subtree is stored in post-order, so every operand is lowered before
+  // the node using it
+  size_t base = m_values.size();
+  for (uint32_t id = m_tree.get(t_expression).m_first;
+       id <= t_expression.getId(); ++id) {
+    if (!lowerExpressionNode(m_tree.get(nodeRef(id)))) {
+      m_values.resize(base);
+      return {};
+    }
+  }
+
+  llvm::Value *result = m_values.back();
+  m_values.pop_back();
+  return result;
+}
+
+std::optional<llvm::Value *>
+Lowering::lowerCondition(expressionRef t_condition) {
+  std::optional<llvm::Value *> conditionCode = lowerExpression(t_condition);
+  if (!conditionCode) {
+    return {};
+  }
+
+  // numbers are compared to 0
+  llvm::Type *type = (*conditionCode)->getType();
+  if (type->isIntegerTy(1)) {
+    return conditionCode;
+  }
+  if (type->isFloatingPointTy()) {
+    return m_gen.m_builder.CreateFCmpONE(*conditionCode,
+                                         llvm::ConstantFP::get(type, 0.0));
+  }
+  return m_gen.m_builder.CreateICmpNE(*conditionCode,
+                                      llvm::ConstantInt::get(type, 0));
+}
+
+GenStatus Lowering::lowerLine(lineRef t_line) {
+  const Node &node = m_tree.get(t_line);
+  switch (node.m_kind) {
+  case NodeKind::conditional:
+    return lowerConditional(node);
+  case NodeKind::whileLoop:
+    return lowerWhile(node);
+  case NodeKind::forLoop:
+    if (m_tree.hasAttribute(node.m_attributes, AttributeKind::parallel)) {
+      return lowerParallelFor(t_line);
+    }
+    return lowerFor(node);
+  case NodeKind::declaration:
+    return lowerDeclaration(node);
+  case NodeKind::returnLine:
+    return lowerReturn(node);
+  default:
+    if (lowerExpression(t_line)) {
+      return GenStatus::ok;
+    }
+    return GenStatus::error;
+  }
+}
+
+GenStatus Lowering::lowerConditional(const Node &t_node) {
+  // create blocks
+  llvm::Function *functionCode = m_gen.m_builder.GetInsertBlock()->getParent();
+
+  llvm::BasicBlock *mergedBB =
+      llvm::BasicBlock::Create(*m_gen.m_context, "", functionCode);
+  llvm::BasicBlock *checkBB = m_gen.m_builder.GetInsertBlock();
+  unsigned numBlocks = t_node.m_list.size();
+  // constant folding can leave only the else block
+  llvm::BasicBlock *nextBB =
+      numBlocks ? llvm::BasicBlock::Create(*m_gen.m_context, "", functionCode)
+                : nullptr;
+
+  bool allTerminated = true;
+
+  for (unsigned i = 0; i < numBlocks; ++i) {
+    // condition
+    std::optional<llvm::Value *> comparisonCode =
+        lowerCondition(m_tree.at(t_node.m_list, i));
+    if (!comparisonCode) {
+      return GenStatus::error;
+    }
+
+    // create the block with the code
+    llvm::BasicBlock *codeBB =
+        llvm::BasicBlock::Create(*m_gen.m_context, "", functionCode);
+
+    // create the conditional branch
+    m_gen.m_builder.CreateCondBr(*comparisonCode, codeBB, nextBB);
+    m_gen.m_builder.SetInsertPoint(codeBB);
+
+    bool currTerminated = false;
+    for (lineRef line : m_tree.items(m_tree.at(t_node.m_blocks, i))) {
+      GenStatus mainResult = lowerLine(line);
+      if (mainResult == GenStatus::error) {
+        return GenStatus::error;
+      }
+      if (mainResult == GenStatus::terminated) { // only one terminator allowed
+        currTerminated = true;
+        break;
+      }
+    }
+
+    // after it's finished, go to the merged block
+    if (!currTerminated) {
+      allTerminated = false;
+      m_gen.m_builder.CreateBr(mergedBB);
+    }
+
+    checkBB = nextBB;
+
+    // I feel like there's a better way to do this...
+    if (i < numBlocks - 1) {
+      nextBB = llvm::BasicBlock::Create(*m_gen.m_context, "", functionCode);
+    }
+
+    m_gen.m_builder.SetInsertPoint(checkBB);
+  }
+
+  // checkBB is now the else block
+
+  // generate code for the else block
+  bool elseTerminated = false;
+  if (t_node.m_blocks.size() > numBlocks) {
+    for (lineRef line : m_tree.items(m_tree.at(t_node.m_blocks, numBlocks))) {
+      GenStatus elseResult = lowerLine(line);
+      if (elseResult == GenStatus::error) {
+        return GenStatus::error;
+      } else if (elseResult == GenStatus::terminated) {
+        elseTerminated = true;
+        break;
+      }
+    }
+  }
+
+  // go back to merged block
+  if (!elseTerminated) {
+    m_gen.m_builder.CreateBr(mergedBB);
+  }
+
+  // create merged block
+  if (!allTerminated || !elseTerminated) {
+    m_gen.m_builder.SetInsertPoint(mergedBB);
+  } else {
+    llvm::DeleteDeadBlock(mergedBB);
+    return GenStatus::terminated;
+  }
+  // placeholder. the structure will be changed soon
+  return GenStatus::ok;
+}
+
+llvm::MDNode *Lowering::makeLoopMetadata(ArenaList<Attribute> t_attributes) {
+  if (t_attributes.empty()) {
+    return nullptr;
+  }
+
+  llvm::LLVMContext &context = *m_gen.m_context;
+  auto hint = [&](llvm::StringRef t_name,
+                  std::optional<llvm::Metadata *> t_value = {}) {
+    std::vector<llvm::Metadata *> operands = {
+        llvm::MDString::get(context, t_name)};
+    if (t_value) {
+      operands.push_back(*t_value);
+    }
+    return llvm::MDNode::get(context, operands);
+  };
+  auto number = [&](llvm::Type *t_type, uint64_t t_value) {
+    return llvm::ConstantAsMetadata::get(
+        llvm::ConstantInt::get(t_type, t_value));
+  };
+
+  // the first operand is the loop id itself, filled in below
+  std::vector<llvm::Metadata *> operands = {nullptr};
+  for (const Attribute &attribute : m_tree.items(t_attributes)) {
+    switch (attribute.m_kind) {
+    case AttributeKind::unroll:
+      operands.push_back(
+          attribute.m_value
+              ? hint("llvm.loop.unroll.count",
+                     number(m_gen.m_builder.getInt32Ty(), attribute.m_value))
+              : hint("llvm.loop.unroll.full"));
+      break;
+    case AttributeKind::noUnroll:
+      operands.push_back(hint("llvm.loop.unroll.disable"));
+      break;
+    case AttributeKind::vectorize:
+      operands.push_back(hint("llvm.loop.vectorize.enable",
+                              number(m_gen.m_builder.getInt1Ty(), 1)));
+      if (attribute.m_value) {
+        operands.push_back(
+            hint("llvm.loop.vectorize.width",
+                 number(m_gen.m_builder.getInt32Ty(), attribute.m_value)));
+      }
+      break;
+    case AttributeKind::noVectorize:
+      // a width of 1 is how the vectorizer is turned off for a loop
+      operands.push_back(hint("llvm.loop.vectorize.width",
+                              number(m_gen.m_builder.getInt32Ty(), 1)));
+      break;
+    default:
+      break;
+    }
+  }
+
+  llvm::MDNode *loopID = llvm::MDNode::getDistinct(context, operands);
+  loopID->replaceOperandWith(0, loopID);
+  return loopID;
+}
+
+GenStatus Lowering::lowerLoop(const Node &t_node, expressionRef t_condition,
+                              lineRef t_updation) {
+  // Loops are lowered into the shape LLVM's loop passes expect:
+  //   header: the condition, checked before every iteration
+  //   body:   the lines of the loop
+  //   latch:  the updation of a for loop, then the only branch back
+  //   exit:   the code after the loop
+  llvm::Function *functionCode = m_gen.m_builder.GetInsertBlock()->getParent();
+  llvm::BasicBlock *headerBB =
+      llvm::BasicBlock::Create(*m_gen.m_context, "", functionCode);
+  llvm::BasicBlock *bodyBB =
+      llvm::BasicBlock::Create(*m_gen.m_context, "", functionCode);
+  llvm::BasicBlock *latchBB =
+      llvm::BasicBlock::Create(*m_gen.m_context, "", functionCode);
+  llvm::BasicBlock *exitBB =
+      llvm::BasicBlock::Create(*m_gen.m_context, "", functionCode);
+
+  m_gen.m_builder.CreateBr(headerBB);
+
+  // header
+  m_gen.m_builder.SetInsertPoint(headerBB);
+  std::optional<llvm::Value *> comparisonCode = lowerCondition(t_condition);
+  if (!comparisonCode) {
+    return GenStatus::error;
+  }
+  m_gen.m_builder.CreateCondBr(*comparisonCode, bodyBB, exitBB);
+
+  // body
+  m_gen.m_builder.SetInsertPoint(bodyBB);
+  bool terminated = false;
+  for (lineRef line : m_tree.items(t_node.m_list)) {
+    GenStatus lineResult = lowerLine(line);
+    if (lineResult == GenStatus::error) {
+      return GenStatus::error;
+    }
+    if (lineResult == GenStatus::terminated) {
+      terminated = true;
+      break;
+    }
+  }
+
+  // latch, unless every iteration returns
+  if (terminated) {
+    llvm::DeleteDeadBlock(latchBB);
+  } else {
+    m_gen.m_builder.CreateBr(latchBB);
+    m_gen.m_builder.SetInsertPoint(latchBB);
+
+    GenStatus updationResult = GenStatus::ok;
+    if (t_updation.isValid()) {
+      updationResult = lowerLine(t_updation);
+    }
+    if (updationResult == GenStatus::error) {
+      return GenStatus::error;
+    }
+
+    // the loop hints go on the back edge
+    if (updationResult == GenStatus::ok) {
+      llvm::BranchInst *backEdge = m_gen.m_builder.CreateBr(headerBB);
+      if (llvm::MDNode *loopID = makeLoopMetadata(t_node.m_attributes)) {
+        backEdge->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+      }
+    }
+  }
+
+  // exit, which is reached whenever the condition is false
+  m_gen.m_builder.SetInsertPoint(exitBB);
+  return GenStatus::ok;
+}
+
+std::optional<std::pair<Symbol, Symbol>>
+Lowering::findSafeIndex(const Node &t_node) {
+  // for let i = start; i < len(a); i += step { ... }
+  // where start and step are literals that aren't negative and positive, and
+  // neither i nor a are assigned in the body
+  const Node &initialization = m_tree.get(t_node.m_operands[0]);
+  const Node &condition = m_tree.get(t_node.m_operands[1]);
+  const Node &updation = m_tree.get(t_node.m_operands[2]);
+  if (initialization.m_kind != NodeKind::declaration ||
+      !initialization.m_operands[0].isValid()) {
+    return {};
+  }
+  const Node &start = m_tree.get(initialization.m_operands[0]);
+  if (start.m_kind != NodeKind::number || start.m_number < 0) {
+    return {};
+  }
+
+  if (condition.m_kind != NodeKind::binaryOp ||
+      condition.m_op != OpCode::lesser) {
+    return {};
+  }
+  const Node &index = m_tree.get(condition.m_operands[0]);
+  const Node &length = m_tree.get(condition.m_operands[1]);
+  if (index.m_kind != NodeKind::variable ||
+      index.m_name != initialization.m_name ||
+      length.m_kind != NodeKind::call || length.m_list.size() != 1 ||
+      getBuiltin(symbols().getName(length.m_name)) != Builtin::len) {
+    return {};
+  }
+  const Node &array = m_tree.get(m_tree.at(length.m_list, 0));
+  if (array.m_kind != NodeKind::variable) {
+    return {};
+  }
+
+  if (updation.m_kind != NodeKind::assignmentOp ||
+      updation.m_op != OpCode::plusEq || updation.m_name != index.m_name) {
+    return {};
+  }
+  const Node &step = m_tree.get(updation.m_operands[0]);
+  if (step.m_kind != NodeKind::number || step.m_number <= 0) {
+    return {};
+  }
+
+  // the nodes of each line are the range ending at it
+  for (lineRef line : m_tree.items(t_node.m_list)) {
+    for (uint32_t id = m_tree.get(line).m_first; id <= line.getId(); ++id) {
+      const Node &node = m_tree.get(nodeRef(id));
+      if (node.m_kind == NodeKind::assignmentOp &&
+          (node.m_name == index.m_name || node.m_name == array.m_name)) {
+        return {};
+      }
+    }
+  }
+  return std::pair(index.m_name, array.m_name);
+}
+
+GenStatus Lowering::lowerWhile(const Node &t_node) {
+  return lowerLoop(t_node, t_node.m_operands[0], lineRef());
+}
+
+GenStatus Lowering::lowerFor(const Node &t_node) {
+  // intialization
+  GenStatus initializationResult = lowerLine(t_node.m_operands[0]);
+  if (initializationResult != GenStatus::ok) {
+    return initializationResult;
+  }
+
+  auto safeIndex = findSafeIndex(t_node);
+  if (safeIndex) {
+    m_safeIndices.push_back(*safeIndex);
+  }
+  GenStatus result =
+      lowerLoop(t_node, t_node.m_operands[1], t_node.m_operands[2]);
+  if (safeIndex) {
+    m_safeIndices.pop_back();
+  }
+  return result;
+}
+
+bool Lowering::lowerParallelBody(llvm::Function *t_function, const Node &t_loop,
+                                 const std::vector<Capture> &t_captures,
+                                 llvm::StructType *t_contextType) {
+  llvm::Value *context = t_function->getArg(0);
+  llvm::Value *begin = t_function->getArg(1);
+  llvm::Value *end = t_function->getArg(2);
+  context->setName("context");
+  begin->setName("begin");
+  end->setName("end");
+  m_gen.m_builder.SetInsertPoint(
+      llvm::BasicBlock::Create(*m_gen.m_context, "", t_function));
+
+  // the variables the body reads are copied out of the context, and the
+  // ones it adds to start at 0 and are added to their slot at the end
+  std::vector<std::pair<llvm::Value *, llvm::AllocaInst *>> reductions;
+  for (unsigned i = 0; i < t_captures.size(); ++i) {
+    const Capture &capture = t_captures[i];
+    llvm::Value *field =
+        m_gen.m_builder.CreateStructGEP(t_contextType, context, i);
+    llvm::AllocaInst *variable = createVariable(capture.m_type, capture.m_name);
+    m_gen.m_namedValues[capture.m_name] = variable;
+    if (capture.m_reduction) {
+      m_gen.m_builder.CreateStore(llvm::Constant::getNullValue(capture.m_type),
+                                  variable);
+      reductions.emplace_back(
+          m_gen.m_builder.CreateLoad(m_gen.m_builder.getPtrTy(), field),
+          variable);
+    } else {
+      m_gen.m_builder.CreateStore(
+          m_gen.m_builder.CreateLoad(capture.m_type, field), variable);
+    }
+  }
+
+  // the same loop as a for loop, over the iterations of this chunk
+  const Node &initialization = m_tree.get(t_loop.m_operands[0]);
+  llvm::Type *indexType = lowerType(initialization.m_type);
+  llvm::AllocaInst *index = createVariable(indexType, initialization.m_name);
+  m_gen.m_namedValues[initialization.m_name] = index;
+  m_gen.m_builder.CreateStore(m_gen.m_builder.CreateTrunc(begin, indexType),
+                              index);
+
+  llvm::BasicBlock *headerBB =
+      llvm::BasicBlock::Create(*m_gen.m_context, "", t_function);
+  llvm::BasicBlock *bodyBB =
+      llvm::BasicBlock::Create(*m_gen.m_context, "", t_function);
+  llvm::BasicBlock *exitBB =
+      llvm::BasicBlock::Create(*m_gen.m_context, "", t_function);
+  m_gen.m_builder.CreateBr(headerBB);
+
+  m_gen.m_builder.SetInsertPoint(headerBB);
+  llvm::Value *indexCode = m_gen.m_builder.CreateSExt(
+      m_gen.m_builder.CreateLoad(indexType, index), end->getType());
+  m_gen.m_builder.CreateCondBr(m_gen.m_builder.CreateICmpSLT(indexCode, end),
+                               bodyBB, exitBB);
+
+  m_gen.m_builder.SetInsertPoint(bodyBB);
+  auto safeIndex = findSafeIndex(t_loop);
+  if (safeIndex) {
+    m_safeIndices.push_back(*safeIndex);
+  }
+  bool lowered = true;
+  for (lineRef line : m_tree.items(t_loop.m_list)) {
+    if (lowerLine(line) != GenStatus::ok) {
+      lowered = false;
+      break;
+    }
+  }
+  if (safeIndex) {
+    m_safeIndices.pop_back();
+  }
+  if (!lowered) {
+    return false;
+  }
+  m_gen.m_builder.CreateStore(
+      m_gen.m_builder.CreateNSWAdd(m_gen.m_builder.CreateLoad(indexType, index),
+                                   llvm::ConstantInt::get(indexType, 1)),
+      index);
+  llvm::BranchInst *backEdge = m_gen.m_builder.CreateBr(headerBB);
+  if (llvm::MDNode *loopID = makeLoopMetadata(t_loop.m_attributes)) {
+    backEdge->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+  }
+
+  // other chunks add to the same slots at the same time
+  m_gen.m_builder.SetInsertPoint(exitBB);
+  for (auto [slot, variable] : reductions) {
+    llvm::Type *type = variable->getAllocatedType();
+    m_gen.m_builder.CreateAtomicRMW(
+        type->isFloatingPointTy() ? llvm::AtomicRMWInst::FAdd
+                                  : llvm::AtomicRMWInst::Add,
+        slot, m_gen.m_builder.CreateLoad(type, variable), llvm::MaybeAlign(),
+        llvm::AtomicOrdering::Monotonic);
+  }
+  m_gen.m_builder.CreateRetVoid();
+
+  if (llvm::verifyFunction(*t_function, &llvm::errs())) {
+    return false;
+  }
+  t_function->setDoesNotThrow();
+  m_gen.addTargetAttributes(*t_function);
+  m_gen.m_funcPass.run(*t_function, m_gen.m_funcAnalyzer);
+  return true;
+}
+
+GenStatus Lowering::lowerParallelFor(lineRef t_loop) {
+  // The body becomes a function that the runtime calls from its threads on
+  // chunks of the range:
+  //   void body(ptr context, i64 begin, i64 end)
+  // The context has the value of every variable from outside the loop that
+  // the body reads, and a slot for each one it adds to, whose parts are
+  // added to the variable once the loop is done
+  const Node &loop = m_tree.get(t_loop);
+  const Node &initialization = m_tree.get(loop.m_operands[0]);
+  const Node &condition = m_tree.get(loop.m_operands[1]);
+
+  // the range, whose end is found once before the loop starts
+  GenStatus initializationResult = lowerLine(loop.m_operands[0]);
+  if (initializationResult != GenStatus::ok) {
+    return initializationResult;
+  }
+  auto endCode = lowerExpression(condition.m_operands[1]);
+  if (!endCode) {
+    return GenStatus::error;
+  }
+  llvm::AllocaInst *index = m_gen.m_namedValues[initialization.m_name];
+  llvm::Type *indexType = index->getAllocatedType();
+  llvm::Type *i64 = m_gen.m_builder.getInt64Ty();
+  llvm::Value *begin = m_gen.m_builder.CreateSExt(
+      m_gen.m_builder.CreateLoad(indexType, index), i64);
+  llvm::Value *end =
+      m_gen.m_builder.CreateSExt(convert(*endCode, indexType), i64);
+
+  // the variables from outside the loop that the body uses, which the type
+  // checker allowed
+  LoopBody loopBody = m_tree.getLoopBody(t_loop);
+  std::vector<Capture> captures;
+  std::unordered_map<Symbol, size_t> captured;
+  for (uint32_t id = loopBody.m_first; id < loopBody.m_end; ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    if ((node.m_kind != NodeKind::variable &&
+         node.m_kind != NodeKind::assignmentOp) ||
+        loopBody.m_locals.count(node.m_name)) {
+      continue;
+    }
+    auto variable = m_gen.m_namedValues.find(node.m_name);
+    if (variable == m_gen.m_namedValues.end()) {
+      llvm::errs() << "Unknown variable name.\n";
+      return GenStatus::error;
+    }
+    auto [position, added] = captured.emplace(node.m_name, captures.size());
+    if (added) {
+      captures.push_back(
+          {node.m_name, variable->second->getAllocatedType(), false});
+    }
+    if (node.m_kind == NodeKind::assignmentOp) {
+      captures[position->second].m_reduction = true;
+    }
+  }
+
+  // fill in the context
+  std::vector<llvm::Type *> fieldTypes;
+  for (const Capture &capture : captures) {
+    fieldTypes.push_back(capture.m_reduction ? m_gen.m_builder.getPtrTy()
+                                             : capture.m_type);
+  }
+  llvm::StructType *contextType =
+      llvm::StructType::get(*m_gen.m_context, fieldTypes);
+  llvm::AllocaInst *context = createVariable(contextType, "context");
+  std::vector<std::pair<Symbol, llvm::AllocaInst *>> slots;
+  for (unsigned i = 0; i < captures.size(); ++i) {
+    const Capture &capture = captures[i];
+    llvm::Value *field =
+        m_gen.m_builder.CreateStructGEP(contextType, context, i);
+    if (capture.m_reduction) {
+      llvm::AllocaInst *slot = createVariable(
+          capture.m_type,
+          llvm::Twine(symbols().getName(capture.m_name)) + ".sum");
+      m_gen.m_builder.CreateStore(llvm::Constant::getNullValue(capture.m_type),
+                                  slot);
+      m_gen.m_builder.CreateStore(slot, field);
+      slots.emplace_back(capture.m_name, slot);
+    } else {
+      m_gen.m_builder.CreateStore(
+          m_gen.m_builder.CreateLoad(capture.m_type,
+                                     m_gen.m_namedValues[capture.m_name]),
+          field);
+    }
+  }
+
+  // the body is lowered like a function of its own, so the state of this
+  // one is put aside until it's done
+  llvm::Function *function = m_gen.m_builder.GetInsertBlock()->getParent();
+  llvm::Function *body = llvm::Function::Create(
+      llvm::FunctionType::get(m_gen.m_builder.getVoidTy(),
+                              {m_gen.m_builder.getPtrTy(), i64, i64}, false),
+      llvm::Function::InternalLinkage, function->getName() + ".pfor",
+      m_gen.m_module.get());
+  bool lowered;
+  {
+    llvm::IRBuilderBase::InsertPointGuard guard(m_gen.m_builder);
+    auto namedValues = std::move(m_gen.m_namedValues);
+    auto parameters = std::move(m_parameters);
+    m_gen.m_namedValues.clear();
+    m_parameters.clear();
+    llvm::BasicBlock *boundsError = std::exchange(m_boundsError, nullptr);
+    llvm::BasicBlock *recurse = std::exchange(m_recurse, nullptr);
+
+    lowered = lowerParallelBody(body, loop, captures, contextType);
+
+    m_gen.m_namedValues = std::move(namedValues);
+    m_parameters = std::move(parameters);
+    m_boundsError = boundsError;
+    m_recurse = recurse;
+  }
+  if (!lowered) {
+    body->eraseFromParent();
+    return GenStatus::error;
+  }
+
+  llvm::FunctionCallee runtime = m_gen.m_module->getOrInsertFunction(
+      "beaver_parallel_for",
+      llvm::FunctionType::get(
+          m_gen.m_builder.getVoidTy(),
+          {i64, i64, m_gen.m_builder.getPtrTy(), m_gen.m_builder.getPtrTy()},
+          false));
+  m_gen.m_builder.CreateCall(runtime, {begin, end, body, context});
+
+  for (auto [name, slot] : slots) {
+    llvm::AllocaInst *variable = m_gen.m_namedValues[name];
+    llvm::Type *type = variable->getAllocatedType();
+    llvm::Value *value = m_gen.m_builder.CreateLoad(type, variable);
+    llvm::Value *part = m_gen.m_builder.CreateLoad(type, slot);
+    m_gen.m_builder.CreateStore(type->isFloatingPointTy()
+                                    ? m_gen.m_builder.CreateFAdd(value, part)
+                                    : m_gen.m_builder.CreateAdd(value, part),
+                                variable);
+  }
+
+  // the index is left where a for loop would leave it
+  llvm::Value *last = m_gen.m_builder.CreateSelect(
+      m_gen.m_builder.CreateICmpSLT(begin, end), end, begin);
+  m_gen.m_builder.CreateStore(m_gen.m_builder.CreateTrunc(last, indexType),
+                              index);
+  return GenStatus::ok;
+}
+
+GenStatus Lowering::lowerDeclaration(const Node &t_node) {
+  if (m_gen.m_namedValues.find(t_node.m_name) != m_gen.m_namedValues.end()) {
+    llvm::errs() << "Variable '" << symbols().getName(t_node.m_name)
+                 << "' already exists in this scope.\n";
+    return GenStatus::error;
+  }
+  llvm::AllocaInst *inst =
+      createVariable(lowerType(t_node.m_type), t_node.m_name);
+  m_gen.m_namedValues[t_node.m_name] = inst;
+
+  // fixed-size arrays are on the stack, and are filled with zeros every time
+  // they're declared
+  if (t_node.m_number) {
+    llvm::Type *elementType = lowerType(getElementType(t_node.m_type));
+    uint64_t length = static_cast<uint64_t>(t_node.m_number);
+    llvm::AllocaInst *elements = createVariable(
+        llvm::ArrayType::get(elementType, length), t_node.m_name);
+    m_gen.m_builder.CreateMemSet(
+        elements, m_gen.m_builder.getInt8(0),
+        m_gen.m_module->getDataLayout().getTypeAllocSize(
+            elements->getAllocatedType()),
+        elements->getAlign());
+
+    llvm::Value *array = llvm::UndefValue::get(inst->getAllocatedType());
+    array = m_gen.m_builder.CreateInsertValue(array, elements, 0);
+    array = m_gen.m_builder.CreateInsertValue(
+        array, m_gen.m_builder.getInt64(length), 1);
+    m_gen.m_builder.CreateStore(array, inst);
+    return GenStatus::ok;
+  }
+
+  // arrays without a value are empty
+  if (isArray(t_node.m_type) && !t_node.m_operands[0].isValid()) {
+    m_gen.m_builder.CreateStore(
+        llvm::Constant::getNullValue(inst->getAllocatedType()), inst);
+  }
+
+  // let a = blah;
+  if (t_node.m_operands[0].isValid()) {
+    auto valueRes = lowerExpression(t_node.m_operands[0]);
+    if (!valueRes) {
+      return GenStatus::error;
+    }
+
+    m_gen.m_builder.CreateStore(convert(*valueRes, inst->getAllocatedType()),
+                                inst);
+  }
+
+  return GenStatus::ok;
+}
+
+GenStatus Lowering::lowerReturn(const Node &t_node) {
+  auto exprCode = lowerExpression(t_node.m_operands[0]);
+  if (!exprCode) {
+    return GenStatus::error;
+  }
+  llvm::Function *function = m_gen.m_builder.GetInsertBlock()->getParent();
+
+  // the type checker marks calls whose result doesn't have to be converted,
+  // and which aren't passed arrays on this function's stack
+  auto *call = llvm::dyn_cast<llvm::CallInst>(*exprCode);
+  if (call &&
+      m_tree.hasAttribute(t_node.m_attributes, AttributeKind::tailCall)) {
+    // a call to itself becomes a jump back to the start with the arguments
+    // as the new parameters, so it doesn't use any stack
+    if (call->getCalledFunction() == function && m_recurse) {
+      unsigned argIndex = 0;
+      for (llvm::AllocaInst *param : m_parameters) {
+        llvm::Value *value = call->getArgOperand(argIndex++);
+        if (param->getAllocatedType()->isStructTy()) {
+          llvm::Value *array = llvm::UndefValue::get(param->getAllocatedType());
+          array = m_gen.m_builder.CreateInsertValue(array, value, 0);
+          value = m_gen.m_builder.CreateInsertValue(
+              array, call->getArgOperand(argIndex++), 1);
+        }
+        m_gen.m_builder.CreateStore(value, param);
+      }
+      call->eraseFromParent();
+      m_gen.m_builder.CreateBr(m_recurse);
+      return GenStatus::terminated;
+    }
+
+    // other calls reuse the stack frame, which is guaranteed when the
+    // callee's parameters are the same as this function's
+    call->setTailCallKind(call->getFunctionType() == function->getFunctionType()
+                              ? llvm::CallInst::TCK_MustTail
+                              : llvm::CallInst::TCK_Tail);
+  }
+
+  m_gen.m_builder.CreateRet(convert(*exprCode, function->getReturnType()));
+  return GenStatus::terminated;
+}
+
+std::optional<llvm::Function *> Lowering::lowerPrototype(const Node &t_node) {
+  // it may have been declared by an earlier call
+  if (llvm::Function *existing =
+          m_gen.m_module->getFunction(symbols().getName(t_node.m_name))) {
+    return existing;
+  }
+
+  // arrays are passed as a pointer to their elements and their length
+  std::vector<llvm::Type *> paramTypes;
+  for (const Parameter &param : m_tree.items(t_node.m_params)) {
+    if (isArray(param.m_type)) {
+      paramTypes.push_back(m_gen.m_builder.getPtrTy());
+      paramTypes.push_back(m_gen.m_builder.getInt64Ty());
+    } else {
+      paramTypes.push_back(lowerType(param.m_type));
+    }
+  }
+
+  llvm::FunctionType *funcType =
+      llvm::FunctionType::get(lowerType(t_node.m_type), paramTypes, false);
+
+  // add the function to the functions table
+  // it is external until it is defined, since it may come from outside
+  llvm::Function *funcCode = llvm::Function::Create(
+      funcType, llvm::Function::ExternalLinkage,
+      symbols().getName(t_node.m_name), m_gen.m_module.get());
+
+  // Name the arguments
+  unsigned argIndex = 0;
+  for (const Parameter &param : m_tree.items(t_node.m_params)) {
+    std::string_view name = symbols().getName(param.m_name);
+    funcCode->getArg(argIndex)->setName(name);
+    if (isArray(param.m_type)) {
+      llvm::Type *elementType = lowerType(getElementType(param.m_type));
+      funcCode->addParamAttr(
+          argIndex,
+          llvm::Attribute::getWithAlignment(
+              *m_gen.m_context,
+              m_gen.m_module->getDataLayout().getABITypeAlign(elementType)));
+      funcCode->getArg(++argIndex)->setName(llvm::Twine(name) + ".len");
+    }
+    ++argIndex;
+  }
+
+  // written and inferred attributes, which calls in other modules also see
+  // since they lower the same prototype
+  for (const Attribute &attribute : m_tree.items(t_node.m_attributes)) {
+    switch (attribute.m_kind) {
+    case AttributeKind::alwaysInline:
+      funcCode->addFnAttr(llvm::Attribute::AlwaysInline);
+      break;
+    case AttributeKind::noInline:
+      funcCode->addFnAttr(llvm::Attribute::NoInline);
+      break;
+    case AttributeKind::cold:
+      funcCode->addFnAttr(llvm::Attribute::Cold);
+      break;
+    case AttributeKind::hot:
+      funcCode->addFnAttr(llvm::Attribute::Hot);
+      break;
+    case AttributeKind::readNone:
+      funcCode->setDoesNotAccessMemory();
+      break;
+    case AttributeKind::noUnwind:
+      funcCode->setDoesNotThrow();
+      break;
+    case AttributeKind::willReturn:
+      funcCode->addFnAttr(llvm::Attribute::WillReturn);
+      break;
+    default:
+      break;
+    }
+  }
+
+  return funcCode;
+}
+
+std::optional<llvm::Function *> Lowering::lowerFunction(nodeRef t_function) {
+  const Node &node = m_tree.get(t_function);
+  const Node &prototype = m_tree.get(node.m_operands[0]);
+
+  // check for existing function
+  std::optional<llvm::Function *> funcCode =
+      m_gen.m_module->getFunction(symbols().getName(prototype.m_name));
+
+  // create if it doesn't exist
+  if (!*funcCode) {
+    funcCode = lowerPrototype(prototype);
+  }
+
+  if (!funcCode) {
+    return {};
+  }
+  if (!(*funcCode)->empty()) {
+    std::cerr << "Cannot redefine function.\n";
+    return {};
+  }
+
+  // parse the body
+  llvm::BasicBlock *definitionBlock = llvm::BasicBlock::Create(
+      *m_gen.m_context, "",
+      *funcCode); // creates the "block" to be jumped to
+
+  // set code insertion point
+  m_gen.m_builder.SetInsertPoint(definitionBlock);
+
+  // make the only named values the ones defined in the prototype
+  m_gen.m_namedValues.clear();
+  m_boundsError = nullptr;
+  m_parameters.clear();
+  m_recurse = nullptr;
+  unsigned argIndex = 0;
+  for (const Parameter &param : m_tree.items(prototype.m_params)) {
+    llvm::Value *value = (*funcCode)->getArg(argIndex++);
+    if (isArray(param.m_type)) {
+      llvm::Value *array = llvm::UndefValue::get(lowerType(param.m_type));
+      array = m_gen.m_builder.CreateInsertValue(array, value, 0);
+      value = m_gen.m_builder.CreateInsertValue(
+          array, (*funcCode)->getArg(argIndex++), 1);
+    }
+    llvm::AllocaInst *argInst = createVariable(value->getType(), param.m_name);
+    m_gen.m_builder.CreateStore(value, argInst);
+    m_gen.m_namedValues[param.m_name] = argInst;
+    m_parameters.push_back(argInst);
+  }
+
+  // tail calls to itself jump to a block after the parameters are set
+  for (uint32_t id = node.m_first; id < t_function.getId(); ++id) {
+    const Node &line = m_tree.get(nodeRef(id));
+    if (line.m_kind == NodeKind::returnLine &&
+        m_tree.hasAttribute(line.m_attributes, AttributeKind::tailCall) &&
+        m_tree.get(line.m_operands[0]).m_kind == NodeKind::call &&
+        m_tree.get(line.m_operands[0]).m_name == prototype.m_name) {
+      m_recurse =
+          llvm::BasicBlock::Create(*m_gen.m_context, "recurse", *funcCode);
+      m_gen.m_builder.CreateBr(m_recurse);
+      m_gen.m_builder.SetInsertPoint(m_recurse);
+      break;
+    }
+  }
+
+  // parse body
+  for (lineRef line : m_tree.items(node.m_list)) {
+    GenStatus lineResult = lowerLine(line);
+    if (lineResult == GenStatus::error) {
+      // calls lowered earlier can use the function, so only its body goes
+      (*funcCode)->deleteBody();
+      return {};
+    } else if (lineResult == GenStatus::terminated) {
+      break;
+    }
+  }
+
+  // verify the generated code
+  if (llvm::verifyFunction(**funcCode, &llvm::errs())) {
+    (*funcCode)->deleteBody();
+    return {};
+  }
+
+  (*funcCode)->setCallingConv(llvm::CallingConv::C);
+  m_gen.addTargetAttributes(**funcCode);
+
+  // only main and the exports are called from outside, so everything else
+  // can be internal and removed by the module pipeline once it's inlined
+  bool exported = m_exports && m_exports->count(prototype.m_name);
+  if (!exported && (*funcCode)->getName() != "main") {
+    (*funcCode)->setLinkage(llvm::Function::InternalLinkage);
+  }
+
+  // run optimizations, which at least keep the variables in registers
+  m_gen.m_funcPass.run(**funcCode, m_gen.m_funcAnalyzer);
+
+  return funcCode;
+}
+
+std::optional<llvm::Function *> Lowering::lowerItem(nodeRef t_item) {
+  const Node &node = m_tree.get(t_item);
+  switch (node.m_kind) {
+  case NodeKind::prototype:
+    return lowerPrototype(node);
+  case NodeKind::function:
+    return lowerFunction(t_item);
+  default:
+    llvm::errs() << "Expected a function or an extern.\n";
+    return {};
+  }
+}
+
+bool Lowering::lowerItems(const std::vector<nodeRef> &t_items) {
+  for (nodeRef item : t_items) {
+    if (!lowerItem(item)) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,136 @@
+#ifndef BEAVER_LOWERING_HPP
+#define BEAVER_LOWERING_HPP
+
+#include "builtins.hpp"
+#include "generator.hpp"
+#include "operations.hpp"
+#include "syntaxtree.hpp"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Options for result of code generation
+enum class GenStatus { ok, terminated, error };
+
+// Generates LLVM IR for a syntax tree that has been type checked
+// Lines are lowered by switching on their kind, and expressions by a single
+// pass over their nodes, which are stored in post-order
+class Lowering {
+private:
+  Generator &m_gen;
+  const SyntaxTree &m_tree;
+  // functions that are called from other modules, so they stay external
+  const std::unordered_set<Symbol> *m_exports;
+
+  // prototype of every function in the tree, so that functions that are
+  // defined later or in another module can be declared when they're called
+  std::unordered_map<Symbol, nodeRef> m_signatures;
+
+  // values of the expression nodes that haven't been used yet
+  std::vector<llvm::Value *> m_values;
+
+  // indices that are known to be in bounds of an array, as the variables
+  // of the index and the array, while the loop that ensures it is lowered
+  std::vector<std::pair<Symbol, Symbol>> m_safeIndices;
+  // block of the current function that reports an index out of bounds,
+  // created when it's first needed
+  llvm::BasicBlock *m_boundsError = nullptr;
+  // variables of the parameters of the current function, and the block
+  // after they're set, where calls to itself in tail position jump back to
+  // if it makes any
+  std::vector<llvm::AllocaInst *> m_parameters;
+  llvm::BasicBlock *m_recurse = nullptr;
+
+  // a variable from outside a pfor loop that its body uses, which the body
+  // either gets a copy of or adds to
+  struct Capture {
+    Symbol m_name;
+    llvm::Type *m_type;
+    bool m_reduction;
+  };
+
+  llvm::Type *lowerType(ValueType t_type);
+  // convert a value that the type checker allows to be used as t_type
+  llvm::Value *convert(llvm::Value *t_value, llvm::Type *t_type);
+
+  // a stack slot for a variable, at the start of the function so that it's
+  // only allocated once and can be promoted to a register
+  llvm::AllocaInst *createVariable(llvm::Type *t_type, Symbol t_name);
+  llvm::AllocaInst *createVariable(llvm::Type *t_type,
+                                   const llvm::Twine &t_name);
+
+  llvm::BasicBlock *getBoundsError();
+  // continue in a new block if t_inBounds is true
+  void checkBounds(llvm::Value *t_inBounds);
+  // the index of an index node as an i64, after checking that it's less
+  // than t_length unless it's known to be
+  llvm::Value *lowerIndex(const Node &t_node, llvm::Value *t_index,
+                          llvm::Value *t_length);
+  // pointer to the element of an array that t_node indexes
+  llvm::Value *lowerElementPointer(const Node &t_node, llvm::Value *t_array,
+                                   llvm::Value *t_index);
+  // pointer to the elements of an array that are loaded into or stored from
+  // a vector, after checking that they're all in bounds
+  llvm::Value *lowerLanesPointer(llvm::Value *t_array, llvm::Value *t_index,
+                                 llvm::FixedVectorType *t_type);
+  // the arguments of a builtin are the last t_node.m_list.size() values
+  llvm::Value *lowerBuiltin(const Node &t_node, Builtin t_builtin);
+  // a slice of a constant global with the elements of an arrayData node
+  llvm::Constant *lowerArrayData(const Node &t_node);
+
+  std::optional<llvm::Value *> lowerExpression(expressionRef t_expression);
+  // an i1 that's true if the condition holds
+  std::optional<llvm::Value *> lowerCondition(expressionRef t_condition);
+  // returns false if the node couldn't be lowered
+  bool lowerExpressionNode(const Node &t_node);
+  GenStatus lowerLine(lineRef t_line);
+  GenStatus lowerConditional(const Node &t_node);
+  // llvm.loop metadata for the attributes of a loop, or nullptr if it has
+  // none
+  llvm::MDNode *makeLoopMetadata(ArenaList<Attribute> t_attributes);
+  // shared by while and for loops, t_updation may be empty
+  GenStatus lowerLoop(const Node &t_node, expressionRef t_condition,
+                      lineRef t_updation);
+  // the index variable and array of a for loop whose index is always in
+  // bounds of the array, if it is one
+  std::optional<std::pair<Symbol, Symbol>> findSafeIndex(const Node &t_node);
+  GenStatus lowerWhile(const Node &t_node);
+  GenStatus lowerFor(const Node &t_node);
+  // the body of a pfor loop as a function that runs the iterations from its
+  // begin argument to its end argument, lowered as a new function
+  bool lowerParallelBody(llvm::Function *t_function, const Node &t_loop,
+                         const std::vector<Capture> &t_captures,
+                         llvm::StructType *t_contextType);
+  GenStatus lowerParallelFor(lineRef t_loop);
+  GenStatus lowerDeclaration(const Node &t_node);
+  GenStatus lowerReturn(const Node &t_node);
+  std::optional<llvm::Function *> lowerPrototype(const Node &t_node);
+  std::optional<llvm::Function *> lowerFunction(nodeRef t_function);
+
+public:
+  Lowering(Generator &t_gen, const SyntaxTree &t_tree,
+           const std::unordered_set<Symbol> *t_exports = nullptr);
+
+  // lower a top-level prototype or function
+  std::optional<llvm::Function *> lowerItem(nodeRef t_item);
+  // lower some of the top-level items, stopping at the first error
+  bool lowerItems(const std::vector<nodeRef> &t_items);
+  // lower every top-level item of the tree
+  bool lowerItems() { return lowerItems(m_tree.getItems()); }
+};
+
+#endif // BEAVER_LOWERING_HPP
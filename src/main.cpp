@@ -1,12 +1,36 @@
+#include "consteval.hpp"
+#include "effects.hpp"
+#include "fingerprint.hpp"
+#include "interface.hpp"
+#include "jit.hpp"
+#include "lowering.hpp"
+#include "objectcache.hpp"
 #include "parser.hpp"
-#include "llvm/ExecutionEngine/ExecutionEngine.h"
-#include "llvm/ExecutionEngine/MCJIT.h"
+#include "typechecker.hpp"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/MC/MCSubtargetInfo.h"
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/SubtargetFeature.h"
+#include "llvm/Transforms/IPO/ThinLTOBitcodeWriter.h"
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+// What to do with the compiled module
+// a module is bitcode and an interface that other programs can import
+enum class EmitKind { jit, object, assembly, bitcode, ir, module };
 
 // return the index of an flag, if it exists
 size_t findOption(int argc, char **argv, const std::string &option) {
@@ -20,6 +44,452 @@ size_t findOption(int argc, char **argv, const std::string &option) {
   return 0;
 }
 
+// return the value of a "--name=value" flag, if it exists
+std::optional<std::string> findValue(int argc, char **argv,
+                                     const std::string &prefix) {
+  for (int i = 0; i < argc; ++i) {
+    if (std::string_view(argv[i]).substr(0, prefix.size()) == prefix) {
+      return std::string(argv[i] + prefix.size());
+    }
+  }
+  return {};
+}
+
+// the arguments that aren't options or their values, which are the input files
+std::vector<std::string> findInputs(int argc, char **argv) {
+  static const std::unordered_set<std::string_view> withValue = {
+      "-target", "-o", "-j", "-cache-dir", "-cache-size", "-I"};
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] != '-') {
+      inputs.push_back(argv[i]);
+    } else if (withValue.count(argv[i])) {
+      ++i;
+    }
+  }
+  return inputs;
+}
+
+// Run t_job(i) for every i below t_count on up to t_threads threads, one of
+// which is the calling thread
+template <typename Job>
+void runParallel(size_t t_count, unsigned t_threads, const Job &t_job) {
+  std::atomic<size_t> next = 0;
+  auto worker = [&]() {
+    for (size_t i = next++; i < t_count; i = next++) {
+      t_job(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min<size_t>(t_count, t_threads); ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+// A source file, which is parsed, checked and lowered on its own
+struct Unit {
+  std::string m_file;
+  // lexed first, and handed to the parser with its tokens once the cache has
+  // been checked
+  std::unique_ptr<MappedFileLexer> m_lexer;
+  TokenBuffer m_tokens;
+  // the modules the file imports, found in the tokens so that the cache key
+  // is known without parsing
+  std::vector<Symbol> m_imports;
+  std::unique_ptr<Parser> m_parser;
+};
+
+// lex the file of a unit and find the modules it imports
+// a misplaced import is left for the parser to report
+bool lexUnit(Unit &t_unit) {
+  t_unit.m_tokens = t_unit.m_lexer->tokenize();
+  for (size_t i = 0; i + 1 < t_unit.m_tokens.size(); ++i) {
+    if (t_unit.m_tokens.getKind(i) == Token::importTok &&
+        t_unit.m_tokens.getKind(i + 1) == Token::identifier) {
+      t_unit.m_imports.push_back(t_unit.m_tokens.getValue(i + 1));
+    }
+  }
+  return true;
+}
+
+// parse the whole file of a unit
+// these return false after reporting an error
+bool parseUnit(Unit &t_unit) {
+  t_unit.m_parser = std::make_unique<Parser>(std::move(t_unit.m_lexer),
+                                             std::move(t_unit.m_tokens));
+  ParserStatus ps = t_unit.m_parser->parseOuter();
+  while (ps == ParserStatus::ok) {
+    ps = t_unit.m_parser->parseOuter();
+  }
+  return ps == ParserStatus::end;
+}
+
+// check and fold a unit once its calls to other units are resolved
+bool checkUnit(Unit &t_unit) {
+  SyntaxTree &tree = t_unit.m_parser->getTree();
+  if (!TypeChecker(tree).check() || !ConstantFolder(tree).fold()) {
+    return false;
+  }
+  EffectAnalysis(tree).infer();
+  return true;
+}
+
+// Declare the functions that a unit calls and another unit defines, as if
+// the unit had declared them with extern
+// They're added to t_exports, since they have to stay visible to the other
+// modules
+// const is left out, since only the unit that defines a const fn can
+// evaluate it
+// returns false if a function is defined in more than one unit
+bool resolveCalls(std::vector<Unit> &t_units,
+                  std::unordered_set<Symbol> &t_exports) {
+  // the unit and prototype of every function
+  std::unordered_map<Symbol, std::pair<size_t, nodeRef>> definitions;
+  for (size_t i = 0; i < t_units.size(); ++i) {
+    const SyntaxTree &tree = t_units[i].m_parser->getTree();
+    for (nodeRef item : tree.getItems()) {
+      const Node &node = tree.get(item);
+      if (node.m_kind != NodeKind::function) {
+        continue;
+      }
+      Symbol name = tree.get(node.m_operands[0]).m_name;
+      auto [definition, inserted] =
+          definitions.emplace(name, std::pair(i, node.m_operands[0]));
+      if (!inserted) {
+        llvm::errs() << "The function '" << symbols().getName(name)
+                     << "' is defined in both "
+                     << t_units[definition->second.first].m_file << " and "
+                     << t_units[i].m_file << ".\n";
+        return false;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < t_units.size(); ++i) {
+    SyntaxTree &tree = t_units[i].m_parser->getTree();
+    std::unordered_set<Symbol> declared;
+    for (nodeRef item : tree.getItems()) {
+      const Node &node = tree.get(item);
+      declared.insert(node.m_kind == NodeKind::function
+                          ? tree.get(node.m_operands[0]).m_name
+                          : node.m_name);
+    }
+
+    // collected first, since declaring them adds nodes to the tree
+    std::vector<Symbol> imports;
+    for (nodeRef item : tree.getItems()) {
+      for (uint32_t id = tree.get(item).m_first; id < item.getId(); ++id) {
+        const Node &node = tree.get(nodeRef(id));
+        if (node.m_kind != NodeKind::call) {
+          continue;
+        }
+        auto definition = definitions.find(node.m_name);
+        if (definition == definitions.end() || definition->second.first == i) {
+          continue;
+        }
+        t_exports.insert(node.m_name);
+        if (declared.insert(node.m_name).second) {
+          imports.push_back(node.m_name);
+        }
+      }
+    }
+
+    for (Symbol name : imports) {
+      auto [unit, ref] = definitions[name];
+      const SyntaxTree &source = t_units[unit].m_parser->getTree();
+      const Node &prototype = source.get(ref);
+      auto params = source.items(prototype.m_params);
+      std::vector<Attribute> attributes;
+      for (const Attribute &attribute : source.items(prototype.m_attributes)) {
+        if (attribute.m_kind != AttributeKind::constant) {
+          attributes.push_back(attribute);
+        }
+      }
+      tree.addItem(tree.addPrototype(
+          name,
+          tree.makeList(std::vector<Parameter>(params.begin(), params.end())),
+          prototype.m_type, tree.makeList(attributes)));
+    }
+  }
+  return true;
+}
+
+// parse bitcode into a module of t_context
+std::unique_ptr<llvm::Module> readBitcode(llvm::MemoryBufferRef t_bitcode,
+                                          llvm::LLVMContext &t_context) {
+  auto module = llvm::parseBitcodeFile(t_bitcode, t_context);
+  if (!module) {
+    llvm::errs() << "Could not read " << t_bitcode.getBufferIdentifier() << ": "
+                 << llvm::toString(module.takeError()) << '\n';
+    return nullptr;
+  }
+  return std::move(*module);
+}
+
+bool linkBitcode(Generator &t_generator, llvm::MemoryBufferRef t_bitcode) {
+  std::unique_ptr<llvm::Module> module =
+      readBitcode(t_bitcode, *t_generator.m_context);
+  if (!module) {
+    return false;
+  }
+  if (llvm::Linker::linkModules(*t_generator.m_module, std::move(module))) {
+    llvm::errs() << "Could not link " << t_bitcode.getBufferIdentifier()
+                 << ".\n";
+    return false;
+  }
+  return true;
+}
+
+// Lower every unit into its own module on its own thread, and link them into
+// the module of t_generator
+// The units get the ThinLTO pre-link pipeline, since the linked module is
+// optimized again, which is when calls between them are inlined
+template <typename MakeTargetMachine>
+bool linkUnits(const std::vector<Unit> &t_units,
+               const std::unordered_set<Symbol> &t_exports,
+               Generator &t_generator,
+               const MakeTargetMachine &t_makeTargetMachine,
+               llvm::OptimizationLevel t_optLevel, unsigned t_threads) {
+  // every module has its own context, so they're moved to the context of
+  // t_generator as bitcode
+  std::vector<llvm::SmallVector<char, 0>> bitcode(t_units.size());
+  std::unique_ptr<bool[]> lowered(new bool[t_units.size()]);
+  runParallel(t_units.size(), t_threads, [&](size_t t_index) {
+    const Unit &unit = t_units[t_index];
+    Generator generator(t_makeTargetMachine(), unit.m_file, t_optLevel, true);
+    Lowering lowering(generator, unit.m_parser->getTree(), &t_exports);
+    lowered[t_index] = lowering.lowerItems();
+    if (lowered[t_index]) {
+      generator.optimize();
+      llvm::raw_svector_ostream stream(bitcode[t_index]);
+      llvm::WriteBitcodeToFile(*generator.m_module, stream);
+    }
+  });
+
+  for (size_t i = 0; i < t_units.size(); ++i) {
+    if (!lowered[i] ||
+        !linkBitcode(t_generator,
+                     llvm::MemoryBufferRef(
+                         llvm::StringRef(bitcode[i].data(), bitcode[i].size()),
+                         t_units[i].m_file))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Once everything is linked, only main is visible outside of the program,
+// like it is when the program is one file
+void internalize(llvm::Module &t_module) {
+  for (llvm::Function &function : t_module) {
+    if (!function.isDeclaration() && function.getName() != "main") {
+      function.setLinkage(llvm::Function::InternalLinkage);
+    }
+  }
+}
+
+// A compiled module that the program imports, directly or through another
+// module
+struct Import {
+  std::string m_name;
+  // the path of its files, without the extension
+  std::string m_path;
+  ModuleInterface m_interface;
+  std::unique_ptr<llvm::MemoryBuffer> m_bitcode;
+};
+
+// Read the modules that the units import
+// The modules they import in turn are read as well, since their code is
+// linked with the program
+// Modules are looked for in the directory of the file that imports them, and
+// then in t_importPaths
+std::optional<std::vector<Import>>
+importModules(const std::vector<Unit> &t_units,
+              const std::vector<std::string> &t_importPaths) {
+  std::vector<Import> imports;
+  std::unordered_map<Symbol, size_t> indices;
+  // find and read a module the first time it's imported
+  auto import = [&](Symbol t_name,
+                    llvm::StringRef t_dir) -> std::optional<size_t> {
+    if (auto found = indices.find(t_name); found != indices.end()) {
+      return found->second;
+    }
+    std::string name(symbols().getName(t_name));
+    std::vector<llvm::StringRef> dirs = {t_dir};
+    dirs.insert(dirs.end(), t_importPaths.begin(), t_importPaths.end());
+    for (llvm::StringRef dir : dirs) {
+      llvm::SmallString<128> path(dir);
+      llvm::sys::path::append(path, name);
+      if (!llvm::sys::fs::exists(path + ".bvi")) {
+        continue;
+      }
+      auto interface = ModuleInterface::read((path + ".bvi").str());
+      if (!interface) {
+        return {};
+      }
+      auto bitcode = llvm::MemoryBuffer::getFile(path + ".bc");
+      if (!bitcode) {
+        llvm::errs() << "Could not open file: " << path << ".bc\n";
+        return {};
+      }
+      indices.emplace(t_name, imports.size());
+      imports.push_back({name, std::string(path), std::move(*interface),
+                         std::move(*bitcode)});
+      return imports.size() - 1;
+    }
+    llvm::errs() << "Could not find the module '" << name
+                 << "', use -I to say where it is.\n";
+    return {};
+  };
+
+  for (const Unit &unit : t_units) {
+    for (Symbol name : unit.m_imports) {
+      if (!import(name, llvm::sys::path::parent_path(unit.m_file))) {
+        return {};
+      }
+    }
+  }
+  // the list grows while it's walked, so the names are copied first
+  for (size_t i = 0; i < imports.size(); ++i) {
+    std::vector<Symbol> names = imports[i].m_interface.m_imports;
+    std::string dir(llvm::sys::path::parent_path(imports[i].m_path));
+    for (Symbol name : names) {
+      if (!import(name, dir)) {
+        return {};
+      }
+    }
+  }
+  return imports;
+}
+
+// Declare the functions of the imported modules in the units that import them
+// the parser finds the same imports as lexUnit, so they've all been read
+bool declareImports(std::vector<Unit> &t_units,
+                    const std::vector<Import> &t_imports) {
+  for (Unit &unit : t_units) {
+    SyntaxTree &tree = unit.m_parser->getTree();
+    for (Symbol name : tree.getImports()) {
+      auto import = std::find_if(
+          t_imports.begin(), t_imports.end(), [&](const Import &t_import) {
+            return t_import.m_name == symbols().getName(name);
+          });
+      if (!import->m_interface.declare(tree, import->m_name)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Split the top-level items into at most t_count groups of consecutive
+// items with about the same number of nodes
+std::vector<std::vector<nodeRef>> splitItems(const SyntaxTree &t_tree,
+                                             size_t t_count) {
+  const std::vector<nodeRef> &items = t_tree.getItems();
+  size_t totalSize = 0;
+  for (nodeRef item : items) {
+    totalSize += item.getId() - t_tree.get(item).m_first + 1;
+  }
+
+  std::vector<std::vector<nodeRef>> groups(1);
+  size_t groupSize = 0;
+  for (nodeRef item : items) {
+    if (groupSize * t_count >= totalSize && groups.size() < t_count) {
+      groups.emplace_back();
+      groupSize = 0;
+    }
+    groups.back().push_back(item);
+    groupSize += item.getId() - t_tree.get(item).m_first + 1;
+  }
+  return groups;
+}
+
+// Find the functions that are called from a different group than the one
+// they're defined in
+std::unordered_set<Symbol>
+findExports(const SyntaxTree &t_tree,
+            const std::vector<std::vector<nodeRef>> &t_groups) {
+  std::unordered_map<Symbol, size_t> definitions;
+  for (size_t i = 0; i < t_groups.size(); ++i) {
+    for (nodeRef item : t_groups[i]) {
+      const Node &node = t_tree.get(item);
+      if (node.m_kind == NodeKind::function) {
+        definitions[t_tree.get(node.m_operands[0]).m_name] = i;
+      }
+    }
+  }
+
+  // the nodes of an item are the range ending at it
+  std::unordered_set<Symbol> exports;
+  for (size_t i = 0; i < t_groups.size(); ++i) {
+    for (nodeRef item : t_groups[i]) {
+      for (uint32_t id = t_tree.get(item).m_first; id < item.getId(); ++id) {
+        const Node &node = t_tree.get(nodeRef(id));
+        if (node.m_kind != NodeKind::call) {
+          continue;
+        }
+        auto definition = definitions.find(node.m_name);
+        if (definition != definitions.end() && definition->second != i) {
+          exports.insert(node.m_name);
+        }
+      }
+    }
+  }
+  return exports;
+}
+
+// Find the functions that main calls, directly or through others, which are
+// the only ones the JIT compiles
+std::unordered_set<Symbol> findReachable(const std::vector<Unit> &t_units) {
+  std::unordered_map<Symbol, std::pair<const SyntaxTree *, nodeRef>> functions;
+  for (const Unit &unit : t_units) {
+    const SyntaxTree &tree = unit.m_parser->getTree();
+    for (nodeRef item : tree.getItems()) {
+      const Node &node = tree.get(item);
+      if (node.m_kind == NodeKind::function) {
+        functions.emplace(tree.get(node.m_operands[0]).m_name,
+                          std::pair(&tree, item));
+      }
+    }
+  }
+
+  std::vector<Symbol> work = {symbols().intern("main")};
+  std::unordered_set<Symbol> reached(work.begin(), work.end());
+  while (!work.empty()) {
+    auto function = functions.find(work.back());
+    work.pop_back();
+    if (function == functions.end()) {
+      continue;
+    }
+    auto [tree, item] = function->second;
+    for (uint32_t id = tree->get(item).m_first; id < item.getId(); ++id) {
+      const Node &node = tree->get(nodeRef(id));
+      if (node.m_kind == NodeKind::call && reached.insert(node.m_name).second) {
+        work.push_back(node.m_name);
+      }
+    }
+  }
+  return reached;
+}
+
+// entry point added to the module with main in JIT runs
+// it has its own name, so calls to main from other modules still work
+constexpr const char *jitEntryPoint = "beaver.entry";
+
+// call the program's main, which prints its result
+int runMain(JIT &t_jit) {
+  auto entryPoint = t_jit.lookup(jitEntryPoint);
+  if (!entryPoint) {
+    llvm::errs() << "No main function found.\n";
+    return 1;
+  }
+  return reinterpret_cast<int (*)()>(*entryPoint)();
+}
+
 int main(int argc, char **argv) {
   // get the string representing the system to compile to
   std::string targetTriple = llvm::sys::getDefaultTargetTriple();
@@ -49,25 +519,54 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  // Use defaults for cpu and features
-  auto CPU = "generic";
-  auto features = "";
-
-  // Initialize the target machine with the target, CPU and features
-  llvm::TargetOptions options;
-  auto targetMachine = target->createTargetMachine(targetTriple, CPU, features,
-                                                   options, llvm::Reloc::PIC_);
-
-  // initialize the generator
-  // Add the data layout and target triple here,
-  // so that we don't need to pass it to the constructor
-  auto generator = std::make_shared<Generator>();
-  generator->m_module.setDataLayout(targetMachine->createDataLayout());
-  generator->m_module.setTargetTriple(targetTriple);
+  // optimization level, O2 unless a flag says otherwise
+  llvm::OptimizationLevel optLevel = llvm::OptimizationLevel::O2;
+  llvm::CodeGenOptLevel codeGenLevel = llvm::CodeGenOptLevel::Default;
+  std::string optName = "-O2";
+  for (const char *name : {"-O0", "-O1", "-O3", "-Os"}) {
+    if (findOption(argc - 1, argv, name)) {
+      optName = name;
+      break;
+    }
+  }
+  if (optName == "-O0") {
+    optLevel = llvm::OptimizationLevel::O0;
+    codeGenLevel = llvm::CodeGenOptLevel::None;
+  } else if (optName == "-O1") {
+    optLevel = llvm::OptimizationLevel::O1;
+    codeGenLevel = llvm::CodeGenOptLevel::Less;
+  } else if (optName == "-O3") {
+    optLevel = llvm::OptimizationLevel::O3;
+    codeGenLevel = llvm::CodeGenOptLevel::Aggressive;
+  } else if (optName == "-Os") {
+    optLevel = llvm::OptimizationLevel::Os;
+  }
 
-  // Default output file: "output.o"
-  // NOTE: this is not used right now
-  std::string outputFile = "output.o";
+  // run the program with the JIT unless an output kind is given
+  EmitKind emitKind = EmitKind::jit;
+  std::string outputFile;
+  if (auto emitName = findValue(argc - 1, argv, "--emit=")) {
+    if (*emitName == "obj") {
+      emitKind = EmitKind::object;
+      outputFile = "output.o";
+    } else if (*emitName == "asm") {
+      emitKind = EmitKind::assembly;
+      outputFile = "output.s";
+    } else if (*emitName == "bc") {
+      emitKind = EmitKind::bitcode;
+      outputFile = "output.bc";
+    } else if (*emitName == "ll") {
+      emitKind = EmitKind::ir;
+      outputFile = "output.ll";
+    } else if (*emitName == "module") {
+      // named after the first input file once it's known
+      emitKind = EmitKind::module;
+    } else {
+      llvm::errs() << "Unknown output kind: " << *emitName
+                   << ". Expected obj, asm, bc, ll or module.\n";
+      return 1;
+    }
+  }
 
   // If a user-defined output file exists, use it
   if (size_t argIndex = findOption(argc - 2, argv, "-o")) {
@@ -78,71 +577,421 @@ int main(int argc, char **argv) {
     outputFile = argv[argIndex + 1];
   }
 
-  // initialize the ouput stream
-  std::error_code errorCode;
-  llvm::raw_fd_ostream outputStream(outputFile, errorCode,
-                                    llvm::sys::fs::OF_None);
+  // directories with the modules that are imported
+  std::vector<std::string> importPaths;
+  for (int i = 1; i < argc - 2; ++i) {
+    if (std::string_view(argv[i]) == "-I") {
+      importPaths.push_back(argv[++i]);
+    }
+  }
+
+  // number of threads for compiling with the JIT
+  unsigned compileThreads = 1;
+  if (size_t argIndex = findOption(argc - 2, argv, "-j")) {
+    compileThreads = std::strtoul(argv[argIndex + 1], nullptr, 10);
+    if (compileThreads == 0) {
+      llvm::errs() << "Expected a positive number of threads.\n";
+      return 1;
+    }
+  }
 
-  if (errorCode) {
-    llvm::errs() << "Could not open file: " << errorCode.message() << '\n';
+  // keep compiled objects between JIT runs
+  // incremental runs keep an object for every few functions, so only the
+  // ones with functions that changed are compiled again
+  bool incremental = findOption(argc - 1, argv, "-incremental");
+  if (incremental && emitKind != EmitKind::jit) {
+    llvm::errs() << "-incremental only works for JIT runs.\n";
     return 1;
   }
+  std::optional<std::string> cacheDir;
+  if (size_t argIndex = findOption(argc - 2, argv, "-cache-dir")) {
+    cacheDir = argv[argIndex + 1];
+  } else if (findOption(argc - 1, argv, "-cache") || incremental) {
+    llvm::SmallString<128> path;
+    if (!llvm::sys::path::cache_directory(path)) {
+      llvm::errs() << "Could not find a cache directory, use -cache-dir.\n";
+      return 1;
+    }
+    llvm::sys::path::append(path, "beaver");
+    cacheDir = std::string(path);
+  }
+  uint64_t cacheSize = 512;
+  if (size_t argIndex = findOption(argc - 2, argv, "-cache-size")) {
+    cacheSize = std::strtoull(argv[argIndex + 1], nullptr, 10);
+    if (cacheSize == 0) {
+      llvm::errs() << "Expected a positive cache size.\n";
+      return 1;
+    }
+  }
+  bool cacheStats = findOption(argc - 1, argv, "-cache-stats");
 
-  // create the lexer and parser
-  // last command line argument is the input file
-  if (argc < 2) {
-    llvm::errs() << "Expected input file.\n";
+  // JIT runs use everything the host has, while code compiled ahead of time
+  // targets a generic cpu so that it runs anywhere
+  std::string CPU = emitKind == EmitKind::jit ? "native" : "generic";
+  if (auto name = findValue(argc - 1, argv, "-mcpu=")) {
+    CPU = *name;
+  }
+  llvm::SubtargetFeatures featureList;
+  if (CPU == "native") {
+    CPU = llvm::sys::getHostCPUName().str();
+    // sorted, so the same host always gives the same cache key
+    llvm::StringMap<bool> hostFeatures;
+    std::vector<std::string> enabled;
+    if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+      for (auto &feature : hostFeatures) {
+        enabled.push_back((feature.second ? "+" : "-") + feature.first().str());
+      }
+    }
+    std::sort(enabled.begin(), enabled.end());
+    for (const std::string &feature : enabled) {
+      featureList.AddFeature(feature);
+    }
+  }
+  // explicit features come last, so they override the host's
+  if (auto attributes = findValue(argc - 1, argv, "-mattr=")) {
+    llvm::SmallVector<llvm::StringRef, 8> names;
+    llvm::StringRef(*attributes).split(names, ',', -1, false);
+    for (llvm::StringRef name : names) {
+      featureList.AddFeature(name);
+    }
+  }
+  std::string features = featureList.getString();
+
+  std::unique_ptr<llvm::MCSubtargetInfo> subtargetInfo(
+      target->createMCSubtargetInfo(targetTriple, "", ""));
+  if (!subtargetInfo || !subtargetInfo->isCPUStringValid(CPU)) {
+    llvm::errs() << "Unknown CPU for " << targetTriple << ": " << CPU << '\n';
+    return 1;
   }
-  std::unique_ptr<Lexer> lex = std::make_unique<FileLexer>(argv[argc - 1]);
-  Parser parse(std::move(lex), generator);
 
-  // parse and generate code
-  ParserStatus ps = parse.parseOuter();
-  while (ps != ParserStatus::end) {
-    ps = parse.parseOuter();
-    if (ps == ParserStatus::error) {
+  // Initialize target machines with the target, CPU and features
+  llvm::TargetOptions options;
+  auto makeTargetMachine = [&]() {
+    return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+        targetTriple, CPU, features, options, llvm::Reloc::PIC_, std::nullopt,
+        codeGenLevel));
+  };
+
+  // the input files are the last command line arguments
+  std::vector<std::string> inputs = findInputs(argc, argv);
+  if (inputs.empty()) {
+    llvm::errs() << "Expected input file.\n";
+    return 1;
+  }
+  std::vector<Unit> units(inputs.size());
+  std::vector<std::string_view> sources;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    units[i].m_file = inputs[i];
+    units[i].m_lexer = std::make_unique<MappedFileLexer>(inputs[i]);
+    if (!units[i].m_lexer->isValid()) {
+      llvm::errs() << "Could not open file: " << inputs[i] << '\n';
       return 1;
     }
+    sources.push_back(units[i].m_lexer->getSource());
+  }
+  if (emitKind == EmitKind::module && outputFile.empty()) {
+    outputFile = llvm::sys::path::stem(inputs[0]).str();
   }
 
-  // Build the JIT engine
-  auto engine =
-      llvm::EngineBuilder(std::unique_ptr<llvm::Module>(&(generator->m_module)))
-          .setErrorStr(&error)
-          .setOptLevel(llvm::CodeGenOptLevel::Default)
-          .setEngineKind(llvm::EngineKind::JIT)
-          .create();
-
-  if (!engine) {
-    llvm::errs() << error << '\n';
+  // the files are lexed, parsed and checked on threads of their own, and the
+  // calls between them are resolved in between
+  // they use every core, so -j only ever adds threads
+  unsigned workers =
+      std::max(compileThreads, std::thread::hardware_concurrency());
+  auto forEachUnit = [&](bool (*t_step)(Unit &)) {
+    std::unique_ptr<bool[]> succeeded(new bool[units.size()]);
+    runParallel(units.size(), workers, [&](size_t t_index) {
+      succeeded[t_index] = t_step(units[t_index]);
+    });
+    return std::all_of(succeeded.get(), succeeded.get() + units.size(),
+                       [](bool t_succeeded) { return t_succeeded; });
+  };
+  if (!forEachUnit(lexUnit)) {
+    return 1;
+  }
+  auto imports = importModules(units, importPaths);
+  if (!imports) {
     return 1;
   }
 
-  // Finalize the engine and call the entry point function
-  engine->finalizeObject();
-  std::function<double()> entryPoint =
-      reinterpret_cast<double (*)()>(engine->getFunctionAddress("main"));
-  if (!entryPoint) {
-    llvm::errs() << "No main function found.\n";
+  // a run of the same sources and imported modules with the same settings
+  // loads the objects of the last one without parsing or compiling anything
+  std::optional<DiskCache> cache;
+  std::string cacheKey;
+  // for objects that don't belong to one run, which are named after their
+  // contents
+  std::string settingsKey;
+  if (cacheDir && emitKind == EmitKind::jit) {
+    cache.emplace(*cacheDir, cacheSize << 20);
+    if (!cache->isValid()) {
+      llvm::errs() << "Could not create cache directory: " << *cacheDir << '\n';
+      return 1;
+    }
+    for (const Import &import : *imports) {
+      llvm::StringRef bitcode = import.m_bitcode->getBuffer();
+      sources.emplace_back(bitcode.data(), bitcode.size());
+    }
+    cacheKey = DiskCache::makeKey(sources, targetTriple, CPU, features, optName,
+                                  compileThreads);
+    settingsKey =
+        DiskCache::makeKey({}, targetTriple, CPU, features, optName, 0);
+
+    if (auto objects = cache->loadManifest(cacheKey)) {
+      auto jit = JIT::create(targetTriple, CPU, features, codeGenLevel,
+                             compileThreads, &*cache);
+      if (!jit) {
+        return 1;
+      }
+      for (auto &object : *objects) {
+        if (!jit->addObject(std::move(object))) {
+          return 1;
+        }
+      }
+      if (cacheStats) {
+        llvm::errs() << "cache: " << cache->getHits() << " hits, "
+                     << cache->getMisses() << " misses\n";
+      }
+      return runMain(*jit);
+    }
+  }
+
+  if (!forEachUnit(parseUnit) || !declareImports(units, *imports)) {
+    return 1;
+  }
+  std::unordered_set<Symbol> exports;
+  if (!resolveCalls(units, exports) || !forEachUnit(checkUnit)) {
     return 1;
   }
-  std::cout << entryPoint() << '\n';
 
-  /*
-  All this code is not used right now, since a JIT is being used in place of a
-  static compiler llvm::legacy::PassManager pass; llvm::CodeGenFileType
-  outputType; if (findOption(argc, argv, "-S")) { outputType =
-  llvm::CodeGenFileType::AssemblyFile; } else { outputType =
-  llvm::CodeGenFileType::ObjectFile;
+  if (emitKind != EmitKind::jit) {
+    // a module keeps all of its functions for the programs that import it,
+    // and only they get an entry point
+    ModuleInterface moduleInterface;
+    if (emitKind == EmitKind::module) {
+      for (const Unit &unit : units) {
+        const SyntaxTree &tree = unit.m_parser->getTree();
+        moduleInterface.addFunctions(tree);
+        moduleInterface.m_imports.insert(moduleInterface.m_imports.end(),
+                                         tree.getImports().begin(),
+                                         tree.getImports().end());
+      }
+      for (const auto &function : moduleInterface.m_functions) {
+        if (symbols().getName(function.m_name) == "main") {
+          llvm::errs() << "A module can't have a main function.\n";
+          return 1;
+        }
+        exports.insert(function.m_name);
+      }
+    }
+
+    // bitcode is optimized again when it's linked, so it gets the ThinLTO
+    // pre-link pipeline
+    Generator generator(makeTargetMachine(),
+                        units.size() == 1 ? inputs[0] : outputFile, optLevel,
+                        emitKind == EmitKind::bitcode ||
+                            emitKind == EmitKind::module);
+
+    // generate code
+    if (units.size() == 1) {
+      Lowering lowering(generator, units[0].m_parser->getTree(), &exports);
+      if (!lowering.lowerItems()) {
+        return 1;
+      }
+    } else if (!linkUnits(units, exports, generator, makeTargetMachine,
+                          optLevel, workers)) {
+      return 1;
+    }
+    if (emitKind != EmitKind::module) {
+      for (const Import &import : *imports) {
+        if (!linkBitcode(generator, import.m_bitcode->getMemBufferRef())) {
+          return 1;
+        }
+      }
+      internalize(*generator.m_module);
+      if (!generator.addEntryPoint()) {
+        return 1;
+      }
+    }
+    generator.optimize();
+
+    // outputFile is the name of a module's files without the extension
+    std::string interfaceFile = outputFile + ".bvi";
+    if (emitKind == EmitKind::module) {
+      outputFile += ".bc";
+    }
+
+    // only opened now, so a failed compile doesn't truncate the output
+    std::error_code errorCode;
+    llvm::raw_fd_ostream outputStream(outputFile, errorCode,
+                                      emitKind == EmitKind::assembly ||
+                                              emitKind == EmitKind::ir
+                                          ? llvm::sys::fs::OF_Text
+                                          : llvm::sys::fs::OF_None);
+    if (errorCode) {
+      llvm::errs() << "Could not open file: " << errorCode.message() << '\n';
+      return 1;
+    }
+
+    switch (emitKind) {
+    case EmitKind::object:
+    case EmitKind::assembly: {
+      llvm::legacy::PassManager pass;
+      if (generator.m_targetMachine->addPassesToEmitFile(
+              pass, outputStream, nullptr,
+              emitKind == EmitKind::object
+                  ? llvm::CodeGenFileType::ObjectFile
+                  : llvm::CodeGenFileType::AssemblyFile)) {
+        llvm::errs() << "The target can't emit this kind of file.\n";
+        return 1;
+      }
+      pass.run(*generator.m_module);
+      break;
+    }
+    case EmitKind::bitcode:
+    case EmitKind::module: {
+      // writes the module summary along with the bitcode, so the file can
+      // take part in ThinLTO
+      llvm::ModulePassManager writer;
+      writer.addPass(llvm::ThinLTOBitcodeWriterPass(outputStream, nullptr));
+      writer.run(*generator.m_module, generator.m_moduleAnalyzer);
+      break;
+    }
+    case EmitKind::ir:
+      generator.m_module->print(outputStream, nullptr);
+      break;
+    case EmitKind::jit:
+      break;
+    }
+    outputStream.flush();
+
+    // written after the bitcode, since importers look for the interface
+    if (emitKind == EmitKind::module && !moduleInterface.write(interfaceFile)) {
+      return 1;
+    }
+    return 0;
   }
 
-  if (targetMachine->addPassesToEmitFile(pass, outputStream, nullptr,
-                                         outputType)) {
-    llvm::errs() << "Invalid file type\n";
+  // Every compile job lowers and optimizes some functions of a file into its
+  // own context and module
+  // a file is split into groups when there are fewer files than -j threads,
+  // and incremental runs give every chunk of functions a module of its own,
+  // named after its fingerprint
+  struct Job {
+    const Unit *m_unit;
+    std::vector<nodeRef> m_items;
+    // cached objects are named after their module
+    std::string m_name;
+    // the functions of an incremental job that other modules call
+    std::unordered_set<Symbol> m_exports;
+  };
+  std::vector<Job> jobs;
+  if (incremental) {
+    // the objects of functions that are never called would never be stored,
+    // so they'd be lowered by every run
+    std::unordered_set<Symbol> reachable = findReachable(units);
+    for (const Unit &unit : units) {
+      Fingerprints fingerprints(unit.m_parser->getTree());
+      // exports only holds the functions that other files call so far
+      for (Fingerprints::Chunk &chunk :
+           fingerprints.getChunks(reachable, exports)) {
+        std::string name =
+            settingsKey + "-" + llvm::utohexstr(chunk.m_fingerprint, true, 16);
+        jobs.push_back({&unit, std::move(chunk.m_items), std::move(name),
+                        std::move(chunk.m_exports)});
+      }
+    }
+  } else {
+    size_t groupsPerUnit = std::max<size_t>(1, compileThreads / units.size());
+    for (const Unit &unit : units) {
+      const SyntaxTree &tree = unit.m_parser->getTree();
+      std::vector<std::vector<nodeRef>> groups =
+          splitItems(tree, groupsPerUnit);
+      exports.merge(findExports(tree, groups));
+      for (std::vector<nodeRef> &group : groups) {
+        std::string name = (cache ? cacheKey + "-" : unit.m_file + "#") +
+                           std::to_string(jobs.size());
+        jobs.push_back({&unit, std::move(group), std::move(name), {}});
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects(jobs.size());
+  std::vector<std::optional<llvm::orc::ThreadSafeModule>> modules(jobs.size());
+  runParallel(jobs.size(), workers, [&](size_t t_index) {
+    const Job &job = jobs[t_index];
+    // functions of incremental runs that haven't changed aren't lowered
+    if (incremental && (objects[t_index] = cache->loadObject(job.m_name))) {
+      return;
+    }
+    Generator generator(makeTargetMachine(), job.m_name, optLevel);
+    Lowering lowering(generator, job.m_unit->m_parser->getTree(),
+                      incremental ? &job.m_exports : &exports);
+    if (!lowering.lowerItems(job.m_items)) {
+      return;
+    }
+    llvm::Function *beaverMain = generator.m_module->getFunction("main");
+    if (beaverMain && !beaverMain->empty() &&
+        !generator.addEntryPoint(jitEntryPoint)) {
+      return;
+    }
+    generator.optimize();
+    modules[t_index] = generator.takeModule();
+  });
+
+  // run main with the JIT
+  // a module that's linked on the thread that needs it links the modules it
+  // calls first, so the stack of incremental runs would grow with every
+  // module in a chain of calls, unless they're linked on a thread pool
+  auto jit =
+      JIT::create(targetTriple, CPU, features, codeGenLevel,
+                  incremental ? std::max(compileThreads, 2u) : compileThreads,
+                  cache ? &*cache : nullptr);
+  if (!jit) {
     return 1;
   }
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (objects[i] ? !jit->addObject(std::move(objects[i]))
+                   : !modules[i] || !jit->addModule(std::move(*modules[i]))) {
+      return 1;
+    }
+  }
+  // imported modules are compiled by the JIT like the program's own
+  for (const Import &import : *imports) {
+    auto context = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> module =
+        readBitcode(import.m_bitcode->getMemBufferRef(), *context);
+    if (!module) {
+      return 1;
+    }
+    // named after the bitcode, so every program that imports the module
+    // shares its object
+    if (cache) {
+      module->setModuleIdentifier(
+          settingsKey + "-" +
+          llvm::utohexstr(llvm::xxh3_64bits(import.m_bitcode->getBuffer()),
+                          true, 16));
+    }
+    if (!jit->addModule(llvm::orc::ThreadSafeModule(std::move(module),
+                                                    std::move(context)))) {
+      return 1;
+    }
+  }
+
+  if (!cache) {
+    return runMain(*jit);
+  }
 
-  pass.run(generator->m_module);
-  outputStream.flush();
-  */
-}
\ No newline at end of file
+  // looking main up compiles everything it needs, so the manifest is
+  // complete before the program runs
+  if (!jit->lookup(jitEntryPoint)) {
+    llvm::errs() << "No main function found.\n";
+    return 1;
+  }
+  cache->writeManifest(cacheKey);
+  cache->evict();
+  if (cacheStats) {
+    llvm::errs() << "cache: " << cache->getHits() << " hits, "
+                 << cache->getMisses() << " misses\n";
+  }
+  return runMain(*jit);
+}
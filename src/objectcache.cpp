@@ -0,0 +1,202 @@
+#include "objectcache.hpp"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+
+// bump when the generated code changes without the key changing
+static constexpr std::string_view cacheFormat = "beaver-cache-2";
+
+// mark a file as recently used, so it's evicted last
+static void touch(const std::string &t_path) {
+  int fd;
+  if (llvm::sys::fs::openFileForReadWrite(
+          t_path, fd, llvm::sys::fs::CD_OpenExisting, llvm::sys::fs::OF_None)) {
+    return;
+  }
+  (void)llvm::sys::fs::setLastAccessAndModificationTime(
+      fd, std::chrono::system_clock::now());
+  (void)llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+}
+
+// write a file so that other runs never see it half written
+static bool writeAtomically(const std::string &t_dir, const std::string &t_path,
+                            llvm::StringRef t_contents) {
+  int fd;
+  llvm::SmallString<128> tempPath;
+  if (llvm::sys::fs::createUniqueFile(t_dir + "/%%%%%%%%.tmp", fd, tempPath)) {
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream out(fd, true);
+    out << t_contents;
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      llvm::sys::fs::remove(tempPath);
+      return false;
+    }
+  }
+  if (llvm::sys::fs::rename(tempPath, t_path)) {
+    llvm::sys::fs::remove(tempPath);
+    return false;
+  }
+  return true;
+}
+
+DiskCache::DiskCache(const std::string &t_dir, uint64_t t_maxSize)
+    : m_dir(t_dir), m_maxSize(t_maxSize) {
+  m_valid = !llvm::sys::fs::create_directories(m_dir);
+}
+
+std::string DiskCache::getPath(std::string_view t_name) const {
+  llvm::SmallString<128> path(m_dir);
+  llvm::sys::path::append(path, t_name);
+  return std::string(path);
+}
+
+std::string DiskCache::makeKey(const std::vector<std::string_view> &t_sources,
+                               const std::string &t_triple,
+                               const std::string &t_cpu,
+                               const std::string &t_features,
+                               std::string_view t_optLevel, unsigned t_groups) {
+  // the fields are separated by a character that can't be in any of them,
+  // so different fields can't run into each other
+  std::string data;
+  for (std::string_view field :
+       {cacheFormat, std::string_view(LLVM_VERSION_STRING),
+        std::string_view(t_triple), std::string_view(t_cpu),
+        std::string_view(t_features), t_optLevel}) {
+    data.append(field);
+    data.push_back('\0');
+  }
+  data.append(std::to_string(t_groups));
+  data.push_back('\0');
+
+  // every source is hashed on its own, so they don't have to be copied, and
+  // the key depends on their order like the generated code does
+  uint64_t settingsHash = llvm::xxh3_64bits(data);
+  std::vector<uint64_t> sourceHashes;
+  for (std::string_view source : t_sources) {
+    sourceHashes.push_back(
+        llvm::xxh3_64bits(llvm::StringRef(source.data(), source.size())));
+  }
+  uint64_t sourceHash = llvm::xxh3_64bits(llvm::ArrayRef<uint8_t>(
+      reinterpret_cast<const uint8_t *>(sourceHashes.data()),
+      sourceHashes.size() * sizeof(uint64_t)));
+  return llvm::utohexstr(settingsHash, true, 16) +
+         llvm::utohexstr(sourceHash, true, 16);
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+DiskCache::loadObject(const std::string &t_name) {
+  std::string path = getPath(t_name + ".o");
+  auto object = llvm::MemoryBuffer::getFile(path);
+  if (!object) {
+    return nullptr;
+  }
+  ++m_hits;
+  touch(path);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_objects.push_back(t_name);
+  return std::move(*object);
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+DiskCache::getObject(const llvm::Module *t_module) {
+  auto object = loadObject(t_module->getModuleIdentifier());
+  if (!object) {
+    ++m_misses;
+  }
+  return object;
+}
+
+void DiskCache::notifyObjectCompiled(const llvm::Module *t_module,
+                                     llvm::MemoryBufferRef t_object) {
+  // a cache that can't be written to only makes runs slower, so failures
+  // are ignored
+  if (!writeAtomically(m_dir, getPath(t_module->getModuleIdentifier() + ".o"),
+                       t_object.getBuffer())) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_objects.push_back(t_module->getModuleIdentifier());
+}
+
+std::optional<std::vector<std::unique_ptr<llvm::MemoryBuffer>>>
+DiskCache::loadManifest(const std::string &t_key) {
+  std::string manifestPath = getPath(t_key + ".manifest");
+  auto manifest = llvm::MemoryBuffer::getFile(manifestPath);
+  if (!manifest) {
+    return {};
+  }
+
+  llvm::SmallVector<llvm::StringRef, 8> names;
+  (*manifest)->getBuffer().split(names, '\n', -1, false);
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects;
+  for (llvm::StringRef name : names) {
+    std::string path = getPath((name + ".o").str());
+    auto object = llvm::MemoryBuffer::getFile(path);
+    if (!object) {
+      // the run is compiled again and writes a new manifest
+      llvm::sys::fs::remove(manifestPath);
+      return {};
+    }
+    objects.push_back(std::move(*object));
+  }
+
+  // only counted once the whole run is known to be cached
+  for (llvm::StringRef name : names) {
+    touch(getPath((name + ".o").str()));
+  }
+  touch(manifestPath);
+  m_hits += objects.size();
+  return objects;
+}
+
+void DiskCache::writeManifest(const std::string &t_key) {
+  std::string contents;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const std::string &name : m_objects) {
+      contents += name;
+      contents += '\n';
+    }
+  }
+  (void)writeAtomically(m_dir, getPath(t_key + ".manifest"), contents);
+}
+
+void DiskCache::evict() {
+  std::vector<std::tuple<llvm::sys::TimePoint<>, uint64_t, std::string>> files;
+  uint64_t totalSize = 0;
+  std::error_code errorCode;
+  for (llvm::sys::fs::directory_iterator entry(m_dir, errorCode), end;
+       entry != end && !errorCode; entry.increment(errorCode)) {
+    auto status = entry->status();
+    if (!status || status->type() != llvm::sys::fs::file_type::regular_file) {
+      continue;
+    }
+    files.emplace_back(status->getLastModificationTime(), status->getSize(),
+                       entry->path());
+    totalSize += status->getSize();
+  }
+
+  // oldest first
+  std::sort(files.begin(), files.end());
+  for (auto &[time, size, path] : files) {
+    if (totalSize <= m_maxSize) {
+      break;
+    }
+    if (!llvm::sys::fs::remove(path)) {
+      totalSize -= size;
+    }
+  }
+}
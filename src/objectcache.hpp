@@ -0,0 +1,82 @@
+#ifndef BEAVER_OBJECTCACHE_HPP
+#define BEAVER_OBJECTCACHE_HPP
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Keeps compiled objects in a directory between runs
+// Every object is named after the identifier of its module, which starts
+// with the key of the run that made it. A manifest named after the key lists
+// the objects of the run, so a later run with the same key can load them
+// without parsing or compiling anything
+// The key covers imported modules, which are found by scanning the tokens of
+// the sources for imports
+// Objects that runs share, like those of imported modules and incremental
+// runs, are named after the settings and a hash of what they're made of
+// The least recently used files are deleted once the directory grows past
+// its size limit
+class DiskCache : public llvm::ObjectCache {
+private:
+  std::string m_dir;
+  uint64_t m_maxSize;
+  bool m_valid;
+
+  // objects compiled or loaded by this run, for the manifest
+  // compile threads use the cache at the same time
+  std::mutex m_mutex;
+  std::vector<std::string> m_objects;
+
+  std::atomic<unsigned> m_hits = 0;
+  std::atomic<unsigned> m_misses = 0;
+
+  std::string getPath(std::string_view t_name) const;
+
+public:
+  // creates t_dir if it doesn't exist
+  DiskCache(const std::string &t_dir, uint64_t t_maxSize);
+
+  // false if the directory couldn't be created
+  bool isValid() const { return m_valid; }
+
+  // key of a run, which changes whenever the generated code could
+  // t_sources are the files of the program in the order they're given
+  static std::string makeKey(const std::vector<std::string_view> &t_sources,
+                             const std::string &t_triple,
+                             const std::string &t_cpu,
+                             const std::string &t_features,
+                             std::string_view t_optLevel, unsigned t_groups);
+
+  // an object stored by an earlier run, which is counted as a hit if it's
+  // found, so misses are left for the JIT to count
+  std::unique_ptr<llvm::MemoryBuffer> loadObject(const std::string &t_name);
+
+  // called by the JIT before and after compiling a module
+  std::unique_ptr<llvm::MemoryBuffer>
+  getObject(const llvm::Module *t_module) override;
+  void notifyObjectCompiled(const llvm::Module *t_module,
+                            llvm::MemoryBufferRef t_object) override;
+
+  // objects of an earlier run with the same key, or nothing if there was no
+  // such run or any of its objects has been evicted
+  std::optional<std::vector<std::unique_ptr<llvm::MemoryBuffer>>>
+  loadManifest(const std::string &t_key);
+  // record the objects of this run under t_key
+  void writeManifest(const std::string &t_key);
+
+  // delete the least recently used files until the cache fits its limit
+  void evict();
+
+  unsigned getHits() const { return m_hits; }
+  unsigned getMisses() const { return m_misses; }
+};
+
+#endif // BEAVER_OBJECTCACHE_HPP
@@ -1,17 +1,49 @@
 #include "operations.hpp"
 
-std::optional<Operation> getBinOp(std::string t_key) {
-  auto lookup = operations::opKeys.find(t_key);
-  if (lookup == operations::opKeys.end()) {
+std::optional<Operation> getBinOp(OpCode t_op) {
+  switch (t_op) {
+  case OpCode::add:
+    return operations::ADD;
+  case OpCode::sub:
+    return operations::SUB;
+  case OpCode::mult:
+    return operations::MULT;
+  case OpCode::div:
+    return operations::DIV;
+  case OpCode::mod:
+    return operations::MOD;
+  case OpCode::lesser:
+    return operations::LESSER;
+  case OpCode::greater:
+    return operations::GREATER;
+  case OpCode::lesserEq:
+    return operations::LESSEREQ;
+  case OpCode::greaterEq:
+    return operations::GREATEREQ;
+  case OpCode::equalTo:
+    return operations::EQUALTO;
+  case OpCode::notEqTo:
+    return operations::NOTEQTO;
+  default:
     return {};
   }
-  return lookup->second;
 }
 
-std::optional<Operation> getAssignmentOp(std::string t_key) {
-  auto lookup = operations::assignmentKeys.find(t_key);
-  if (lookup == operations::assignmentKeys.end()) {
+std::optional<Operation> getAssignmentOp(OpCode t_op) {
+  switch (t_op) {
+  case OpCode::assign:
+    return operations::ASSIGN;
+  case OpCode::plusEq:
+    return operations::PLUSEQ;
+  case OpCode::minusEq:
+    return operations::MINUSEQ;
+  case OpCode::timesEq:
+    return operations::TIMESEQ;
+  case OpCode::divEq:
+    return operations::DIVEQ;
+  case OpCode::modEq:
+    return operations::MODEQ;
+  default:
     return {};
   }
-  return lookup->second;
-}
\ No newline at end of file
+}
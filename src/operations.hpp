@@ -2,158 +2,171 @@
 #define BEAVER_OPERATIONS_HPP
 
 #include "generator.hpp"
+#include "lexer.hpp"
 #include "llvm/IR/IRBuilder.h"
-#include <map>
 #include <optional>
-#include <string>
 
 // defines an arbitrary operation
 // everything is public since they will all be constant
+// The code depends on the type of the right operand, which the type checker
+// makes the same as the left one: integers and booleans use intCodegen, and
+// floating point values use floatCodegen if there is one
+// Vectors use the code of their lanes, which IRBuilder applies lane by lane
 struct Operation {
+  using Codegen = llvm::Value *(*)(Generator &, llvm::Value *, llvm::Value *);
+
   const int precedence;
-  llvm::Value *(*codegen)(std::shared_ptr<Generator>, llvm::Value *,
-                          llvm::Value *);
+  Codegen intCodegen;
+  Codegen floatCodegen = nullptr;
+
+  llvm::Value *codegen(Generator &t_gen, llvm::Value *t_lhs,
+                       llvm::Value *t_rhs) const {
+    if (floatCodegen && t_rhs->getType()->isFPOrFPVectorTy()) {
+      return floatCodegen(t_gen, t_lhs, t_rhs);
+    }
+    return intCodegen(t_gen, t_lhs, t_rhs);
+  }
 };
 
 namespace operations {
 // Arithmetic operations
-const Operation ADD = {3, [](std::shared_ptr<Generator> t_gen,
-                             llvm::Value *t_lhs, llvm::Value *t_rhs) {
-                         return t_gen->m_builder.CreateFAdd(t_lhs, t_rhs);
-                       }};
-const Operation SUB = {3, [](std::shared_ptr<Generator> t_gen,
-                             llvm::Value *t_lhs, llvm::Value *t_rhs) {
-                         return t_gen->m_builder.CreateFSub(t_lhs, t_rhs);
-                       }};
-const Operation MULT = {4, [](std::shared_ptr<Generator> t_gen,
-                              llvm::Value *t_lhs, llvm::Value *t_rhs) {
-                          return t_gen->m_builder.CreateFMul(t_lhs, t_rhs);
-                        }};
-const Operation DIV = {4, [](std::shared_ptr<Generator> t_gen,
-                             llvm::Value *t_lhs, llvm::Value *t_rhs) {
-                         return t_gen->m_builder.CreateFDiv(t_lhs, t_rhs);
-                       }};
-const Operation MOD = {4, [](std::shared_ptr<Generator> t_gen,
-                             llvm::Value *t_lhs, llvm::Value *t_rhs) {
-                         return t_gen->m_builder.CreateFRem(t_lhs, t_rhs);
-                       }};
+// integers are signed
+const Operation ADD = {
+    3,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateAdd(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFAdd(t_lhs, t_rhs);
+    }};
+const Operation SUB = {
+    3,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateSub(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFSub(t_lhs, t_rhs);
+    }};
+const Operation MULT = {
+    4,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateMul(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFMul(t_lhs, t_rhs);
+    }};
+const Operation DIV = {
+    4,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateSDiv(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFDiv(t_lhs, t_rhs);
+    }};
+const Operation MOD = {
+    4,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateSRem(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFRem(t_lhs, t_rhs);
+    }};
 
 // Comparison operations
+// the result is a bool, and floating point comparisons are unordered
 const Operation LESSER = {
-    2, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      return t_gen->m_builder.CreateUIToFP(
-          t_gen->m_builder.CreateFCmpULT(t_lhs, t_rhs),
-          llvm::Type::getDoubleTy(t_gen->m_builder.getContext()));
+    2,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateICmpSLT(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFCmpULT(t_lhs, t_rhs);
     }};
 const Operation GREATER = {
-    2, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      return t_gen->m_builder.CreateUIToFP(
-          t_gen->m_builder.CreateFCmpUGT(t_lhs, t_rhs),
-          llvm::Type::getDoubleTy(t_gen->m_builder.getContext()));
+    2,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateICmpSGT(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFCmpUGT(t_lhs, t_rhs);
     }};
 const Operation LESSEREQ = {
-    2, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      return t_gen->m_builder.CreateUIToFP(
-          t_gen->m_builder.CreateFCmpULE(t_lhs, t_rhs),
-          llvm::Type::getDoubleTy(t_gen->m_builder.getContext()));
+    2,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateICmpSLE(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFCmpULE(t_lhs, t_rhs);
     }};
 const Operation GREATEREQ = {
-    2, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      return t_gen->m_builder.CreateUIToFP(
-          t_gen->m_builder.CreateFCmpUGE(t_lhs, t_rhs),
-          llvm::Type::getDoubleTy(t_gen->m_builder.getContext()));
+    2,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateICmpSGE(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFCmpUGE(t_lhs, t_rhs);
     }};
 const Operation EQUALTO = {
-    1, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      return t_gen->m_builder.CreateUIToFP(
-          t_gen->m_builder.CreateFCmpUEQ(t_lhs, t_rhs),
-          llvm::Type::getDoubleTy(t_gen->m_builder.getContext()));
+    1,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateICmpEQ(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFCmpUEQ(t_lhs, t_rhs);
     }};
 const Operation NOTEQTO = {
-    1, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      return t_gen->m_builder.CreateUIToFP(
-          t_gen->m_builder.CreateFCmpUNE(t_lhs, t_rhs),
-          llvm::Type::getDoubleTy(t_gen->m_builder.getContext()));
+    1,
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateICmpNE(t_lhs, t_rhs);
+    },
+    [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return t_gen.m_builder.CreateFCmpUNE(t_lhs, t_rhs);
     }};
 
 // Assignment operators
-const Operation ASSIGN = {0, [](std::shared_ptr<Generator> t_gen,
-                                llvm::Value *t_lhs, llvm::Value *t_rhs) {
-                            t_gen->m_builder.CreateStore(t_rhs, t_lhs);
-                            return t_rhs;
-                          }};
+// the left operand is the variable, and the right one has its type
+const Operation ASSIGN = {
+    0, [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      t_gen.m_builder.CreateStore(t_rhs, t_lhs);
+      return t_rhs;
+    }};
+
+// load the variable, apply the operation and store the result
+inline llvm::Value *update(const Operation &t_op, Generator &t_gen,
+                           llvm::Value *t_variable, llvm::Value *t_value) {
+  llvm::LoadInst *load =
+      t_gen.m_builder.CreateLoad(t_value->getType(), t_variable);
+  llvm::Value *res = t_op.codegen(t_gen, load, t_value);
+  t_gen.m_builder.CreateStore(res, t_variable);
+  return res;
+}
 
 const Operation PLUSEQ = {
-    0, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      llvm::LoadInst *load = t_gen->m_builder.CreateLoad(
-          llvm::Type::getDoubleTy(t_gen->m_context), t_lhs);
-      llvm::Value *res = t_gen->m_builder.CreateFAdd(load, t_rhs);
-      t_gen->m_builder.CreateStore(res, t_lhs);
-      return res;
+    0, [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return update(ADD, t_gen, t_lhs, t_rhs);
     }};
-
 const Operation MINUSEQ = {
-    0, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      llvm::LoadInst *load = t_gen->m_builder.CreateLoad(
-          llvm::Type::getDoubleTy(t_gen->m_context), t_lhs);
-      llvm::Value *res = t_gen->m_builder.CreateFSub(load, t_rhs);
-      t_gen->m_builder.CreateStore(res, t_lhs);
-      return res;
+    0, [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return update(SUB, t_gen, t_lhs, t_rhs);
     }};
-
 const Operation TIMESEQ = {
-    0, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      llvm::LoadInst *load = t_gen->m_builder.CreateLoad(
-          llvm::Type::getDoubleTy(t_gen->m_context), t_lhs);
-      llvm::Value *res = t_gen->m_builder.CreateFMul(load, t_rhs);
-      t_gen->m_builder.CreateStore(res, t_lhs);
-      return res;
+    0, [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return update(MULT, t_gen, t_lhs, t_rhs);
     }};
-
 const Operation DIVEQ = {
-    0, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      llvm::LoadInst *load = t_gen->m_builder.CreateLoad(
-          llvm::Type::getDoubleTy(t_gen->m_context), t_lhs);
-      llvm::Value *res = t_gen->m_builder.CreateFDiv(load, t_rhs);
-      t_gen->m_builder.CreateStore(res, t_lhs);
-      return res;
+    0, [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return update(DIV, t_gen, t_lhs, t_rhs);
     }};
-
 const Operation MODEQ = {
-    0, [](std::shared_ptr<Generator> t_gen, llvm::Value *t_lhs,
-          llvm::Value *t_rhs) {
-      llvm::LoadInst *load = t_gen->m_builder.CreateLoad(
-          llvm::Type::getDoubleTy(t_gen->m_context), t_lhs);
-      llvm::Value *res = t_gen->m_builder.CreateFRem(load, t_rhs);
-      t_gen->m_builder.CreateStore(res, t_lhs);
-      return res;
+    0, [](Generator &t_gen, llvm::Value *t_lhs, llvm::Value *t_rhs) {
+      return update(MOD, t_gen, t_lhs, t_rhs);
     }};
 
-// Map of symbols to operations
-const std::map<std::string, Operation> opKeys = {
-    {"+", ADD},        {"-", SUB},      {"*", MULT},    {"/", DIV},
-    {"%", MOD},        {"<", LESSER},   {">", GREATER}, {"<=", LESSEREQ},
-    {">=", GREATEREQ}, {"==", EQUALTO}, {"!=", NOTEQTO}};
-
-// These are stored differently because the LHS needs to be a l-value
-const std::map<std::string, Operation> assignmentKeys = {
-    {"=", ASSIGN},   {"+=", PLUSEQ}, {"-=", MINUSEQ},
-    {"*=", TIMESEQ}, {"/=", DIVEQ},  {"%=", MODEQ}};
-
 } // namespace operations
 
-// find operation given text
-std::optional<Operation> getBinOp(std::string t_key);
-std::optional<Operation> getAssignmentOp(std::string t_key);
+// find operation given the operator classified by the lexer
+// assignment operators are separate because the LHS needs to be a l-value
+std::optional<Operation> getBinOp(OpCode t_op);
+std::optional<Operation> getAssignmentOp(OpCode t_op);
 
-#endif // BEAVER_OPERATIONS_HPP
\ No newline at end of file
+#endif // BEAVER_OPERATIONS_HPP
@@ -1,144 +1,246 @@
 #include "parser.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <utility>
 
 // helper function for blocks
-std::optional<blockPtr> Parser::parseBlock() {
+std::optional<blockRef> Parser::parseBlock() {
   // parse '{'
-  if (m_lexer->getChar() != '{') {
+  if (m_tokens.getChar() != '{') {
     llvm::errs() << "Expected '{'.";
     return {};
   }
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
   // parse body
-  blockPtr result;
-  while (m_lexer->getChar() != '}') {
-    if (m_lexer->getChar() == EOF) {
+  std::vector<lineRef> result;
+  while (m_tokens.getChar() != '}') {
+    if (m_tokens.getChar() == EOF) {
       llvm::errs() << "Expected '}'.";
       return {};
     }
     if (auto line = parseInner()) {
-      result.push_back(std::move(*line));
+      result.push_back(*line);
     } else {
       return {};
     }
-    m_lexer->nextToken();
+    m_tokens.nextToken();
   }
 
   // parse '}'
-  m_lexer->nextToken();
+  m_tokens.nextToken();
+  return m_tree.makeList(result);
+}
+
+std::optional<expressionRef> Parser::parseNum() {
+  auto result = m_tree.addNumber(m_tokens.getNum());
+  m_tokens.nextToken();
   return result;
 }
 
-std::optional<expressionPtr> Parser::parseNum() {
-  auto result = std::make_unique<NumberAST>(m_genData, m_lexer->getNum());
-  m_lexer->nextToken();
-  return std::move(result);
+std::optional<expressionRef> Parser::parseBool() {
+  auto result =
+      m_tree.addNumber(m_tokens.getTok() == Token::trueTok, ValueType::boolean);
+  m_tokens.nextToken();
+  return result;
+}
+
+// the name of a type, after a ':' or "->"
+// if t_length isn't null, the type can be a fixed-size array like "[f64; 4]",
+// and t_length is set to its length
+std::optional<ValueType> Parser::parseType(uint32_t *t_length) {
+  // arrays
+  if (m_tokens.getChar() == '[') {
+    m_tokens.nextToken();
+    auto element = parseType();
+    if (!element) {
+      return {};
+    }
+    auto type = getArrayType(*element);
+    if (!type) {
+      llvm::errs() << "Arrays can't contain " << getTypeName(*element) << ".\n";
+      return {};
+    }
+
+    if (t_length && m_tokens.getChar() == ';') {
+      m_tokens.nextToken();
+      double length =
+          m_tokens.getTok() == Token::number ? m_tokens.getNum() : 0;
+      if (length < 1 || length > UINT32_MAX ||
+          length != static_cast<uint32_t>(length)) {
+        llvm::errs() << "Expected a positive whole number for the length of "
+                        "an array.\n";
+        return {};
+      }
+      *t_length = static_cast<uint32_t>(length);
+      m_tokens.nextToken();
+    }
+
+    if (m_tokens.getChar() != ']') {
+      llvm::errs() << "Expected ']' after array type.\n";
+      return {};
+    }
+    m_tokens.nextToken();
+    return type;
+  }
+
+  if (m_tokens.getTok() != Token::identifier) {
+    llvm::errs() << "Expected type name.\n";
+    return {};
+  }
+  auto type = getTypeFromName(m_tokens.getIdentifier());
+  if (!type) {
+    llvm::errs() << "Unknown type: " << m_tokens.getIdentifier() << '\n';
+    return {};
+  }
+  m_tokens.nextToken();
+  return type;
 }
 
-std::optional<expressionPtr> Parser::parseParens() {
+std::optional<expressionRef> Parser::parseParens() {
   // parse '('
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
   // parse inside expression
   auto exprResult = parseExpression();
 
   // parse ')'
-  if (m_lexer->getChar() != ')') {
+  if (m_tokens.getChar() != ')') {
     llvm::errs() << "Missing ')'\n";
     return {};
   }
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
   return exprResult;
 }
 
-std::optional<expressionPtr> Parser::parseCall(std::string idName) {
+std::optional<expressionRef> Parser::parseCall(Symbol t_callee) {
   // eat '('
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
-  std::vector<expressionPtr> args;
-  while (m_lexer->getChar() != ')') {
+  std::vector<expressionRef> args;
+  while (m_tokens.getChar() != ')') {
     // parse argument
     if (auto argument = parseExpression()) {
-      args.push_back(std::move(*argument));
+      args.push_back(*argument);
     } else {
       return {};
     }
 
     // end of arg list
-    if (m_lexer->getChar() == ')') {
+    if (m_tokens.getChar() == ')') {
       break;
     }
 
     // separator
-    if (m_lexer->getChar() != ',') {
+    if (m_tokens.getChar() != ',') {
       llvm::errs() << "Expected ')' or ',' in argument list.\n";
       return {};
     }
-    m_lexer->nextToken();
+    m_tokens.nextToken();
   }
 
   // parse ')'
-  m_lexer->nextToken();
-  return std::make_unique<CallAST>(m_genData, idName, std::move(args));
+  m_tokens.nextToken();
+  return m_tree.addCall(t_callee, m_tree.makeList(args));
+}
+
+// parse indexing after an array, and an assignment to the element if there
+// is one
+std::optional<expressionRef> Parser::parseIndex(expressionRef t_array) {
+  while (m_tokens.getChar() == '[') {
+    // parse '['
+    m_tokens.nextToken();
+
+    auto index = parseExpression();
+    if (!index) {
+      return {};
+    }
+
+    // parse ']'
+    if (m_tokens.getChar() != ']') {
+      llvm::errs() << "Expected ']' after index.\n";
+      return {};
+    }
+    m_tokens.nextToken();
+
+    // assignment operator
+    OpCode opCode = m_tokens.getOpCode();
+    if (getAssignmentOp(opCode)) {
+      m_tokens.nextToken();
+      auto value = parseExpression();
+      if (!value) {
+        return {};
+      }
+      return m_tree.addIndexAssignmentOp(opCode, t_array, *index, *value);
+    }
+
+    t_array = m_tree.addIndex(t_array, *index);
+  }
+  return t_array;
 }
 
-std::optional<expressionPtr> Parser::parseIdentifier() {
+std::optional<expressionRef> Parser::parseIdentifier() {
   // parse identifier
-  std::string idName = m_lexer->getIdentifier();
-  m_lexer->nextToken();
+  Symbol idName = m_tokens.getSymbol();
+  m_tokens.nextToken();
 
   // function call
-  if (m_lexer->getChar() == '(') {
-    return parseCall(idName);
+  if (m_tokens.getChar() == '(') {
+    auto call = parseCall(idName);
+    if (!call) {
+      return {};
+    }
+    return parseIndex(*call);
   }
 
-  auto op = getAssignmentOp(m_lexer->getOperation());
+  OpCode opCode = m_tokens.getOpCode();
+  auto op = getAssignmentOp(opCode);
 
   // variable
   if (!op) {
-    return std::make_unique<VariableAST>(m_genData, idName);
+    return parseIndex(m_tree.addVariable(idName));
   }
 
   // assignment operator
-  m_lexer->nextToken();
+  m_tokens.nextToken();
   auto expr = parseExpression();
   if (!expr) {
     return {};
   }
-  return std::make_unique<AssignmentOpAST>(m_genData, *op, idName,
-                                           std::move(*expr));
+  return m_tree.addAssignmentOp(opCode, idName, *expr);
 }
 
-bool Parser::parseConditionalBlock(std::vector<blockPtr> &mainBlocks,
-                                   std::vector<expressionPtr> &conditions) {
+bool Parser::parseConditionalBlock(std::vector<blockRef> &mainBlocks,
+                                   std::vector<expressionRef> &conditions) {
   auto condition = parseExpression();
   if (!condition) {
     return 1;
   }
-  conditions.push_back(std::move(*condition));
+  conditions.push_back(*condition);
 
   // parse main block
   auto mainBlock = parseBlock();
   if (!mainBlock) {
     return 1;
   }
-  mainBlocks.push_back(std::move(*mainBlock));
+  mainBlocks.push_back(*mainBlock);
   return 0;
 }
 
-std::optional<linePtr> Parser::parseConditional() {
+std::optional<lineRef> Parser::parseConditional() {
   // parse 'if'
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
-  std::vector<blockPtr> mainBlocks;
-  std::vector<expressionPtr> conditions;
+  std::vector<blockRef> mainBlocks;
+  std::vector<expressionRef> conditions;
 
   parseConditionalBlock(mainBlocks, conditions);
 
-  while (m_lexer->getTok() == Token::elifTok) {
+  while (m_tokens.getTok() == Token::elifTok) {
     // parse "elif"
-    m_lexer->nextToken();
+    m_tokens.nextToken();
 
     if (parseConditionalBlock(mainBlocks, conditions)) {
       return {};
@@ -146,10 +248,10 @@ std::optional<linePtr> Parser::parseConditional() {
   }
 
   // if an else block exists, parse it
-  std::optional<blockPtr> elseBlock;
-  if (m_lexer->getTok() == Token::elseTok) {
+  std::optional<blockRef> elseBlock;
+  if (m_tokens.getTok() == Token::elseTok) {
     // parse "else"
-    m_lexer->nextToken();
+    m_tokens.nextToken();
 
     elseBlock = parseBlock();
     if (!elseBlock) {
@@ -157,14 +259,137 @@ std::optional<linePtr> Parser::parseConditional() {
     }
   }
 
-  return std::make_unique<ConditionalAST>(m_genData, std::move(conditions),
-                                          std::move(mainBlocks),
-                                          std::move(elseBlock));
+  // the else block goes after the other blocks
+  if (elseBlock) {
+    mainBlocks.push_back(*elseBlock);
+  }
+
+  return m_tree.addConditional(m_tree.makeList(conditions),
+                               m_tree.makeList(mainBlocks));
+}
+
+// attributes that can be written before a loop or a function
+struct AttributeInfo {
+  std::string_view name;
+  AttributeKind kind;
+  // whether it can have a number in parentheses
+  bool hasValue;
+  // whether it goes on functions instead of loops
+  bool onFunction;
+};
+static constexpr AttributeInfo attributeInfos[] = {
+    {"unroll", AttributeKind::unroll, true, false},
+    {"nounroll", AttributeKind::noUnroll, false, false},
+    {"vectorize", AttributeKind::vectorize, true, false},
+    {"novectorize", AttributeKind::noVectorize, false, false},
+    {"inline", AttributeKind::alwaysInline, false, true},
+    {"noinline", AttributeKind::noInline, false, true},
+    {"cold", AttributeKind::cold, false, true},
+    {"hot", AttributeKind::hot, false, true},
+    {"tailrec", AttributeKind::tailRec, false, true},
+};
+
+// function attributes that ask for opposite things
+static constexpr std::pair<AttributeKind, AttributeKind> attributeConflicts[] =
+    {{AttributeKind::alwaysInline, AttributeKind::noInline},
+     {AttributeKind::cold, AttributeKind::hot}};
+
+static std::string_view getAttributeName(AttributeKind t_kind) {
+  for (const AttributeInfo &info : attributeInfos) {
+    if (info.kind == t_kind) {
+      return info.name;
+    }
+  }
+  return "";
 }
 
-std::optional<linePtr> Parser::parseWhile() {
+std::optional<std::vector<Attribute>> Parser::parseAttributes(bool t_function) {
+  std::vector<Attribute> result;
+  while (m_tokens.getChar() == '@') {
+    // eat '@'
+    m_tokens.nextToken();
+
+    // attribute name
+    if (m_tokens.getTok() != Token::identifier) {
+      llvm::errs() << "Expected attribute name after '@'.\n";
+      return {};
+    }
+    std::string_view name = m_tokens.getIdentifier();
+    const AttributeInfo *info = std::find_if(
+        std::begin(attributeInfos), std::end(attributeInfos),
+        [&](const AttributeInfo &t_info) { return t_info.name == name; });
+    if (info == std::end(attributeInfos)) {
+      llvm::errs() << "Unknown attribute: @" << name << '\n';
+      return {};
+    }
+    if (info->onFunction != t_function) {
+      llvm::errs() << "@" << name << " can't be used on "
+                   << (t_function ? "functions" : "loops") << ".\n";
+      return {};
+    }
+    m_tokens.nextToken();
+
+    // optional value
+    Attribute attribute = {info->kind, 0};
+    if (m_tokens.getChar() == '(') {
+      m_tokens.nextToken();
+      double value = m_tokens.getTok() == Token::number ? m_tokens.getNum() : 0;
+      if (!info->hasValue || value < 1 || value > UINT32_MAX ||
+          value != static_cast<uint32_t>(value)) {
+        llvm::errs() << "Expected no value or a positive whole number for @"
+                     << name << ".\n";
+        return {};
+      }
+      attribute.m_value = static_cast<uint32_t>(value);
+      m_tokens.nextToken();
+
+      if (m_tokens.getChar() != ')') {
+        llvm::errs() << "Expected ')' after attribute value.\n";
+        return {};
+      }
+      m_tokens.nextToken();
+    }
+    result.push_back(attribute);
+  }
+
+  auto has = [&](AttributeKind t_kind) {
+    return std::any_of(result.begin(), result.end(),
+                       [&](const Attribute &t_attribute) {
+                         return t_attribute.m_kind == t_kind;
+                       });
+  };
+  for (auto [first, second] : attributeConflicts) {
+    if (has(first) && has(second)) {
+      llvm::errs() << "A function can't have both @" << getAttributeName(first)
+                   << " and @" << getAttributeName(second) << ".\n";
+      return {};
+    }
+  }
+  return result;
+}
+
+// a loop with attributes
+std::optional<lineRef> Parser::parseLoop() {
+  auto attributes = parseAttributes(false);
+  if (!attributes) {
+    return {};
+  }
+
+  switch (m_tokens.getTok()) {
+  case Token::whileTok:
+    return parseWhile(m_tree.makeList(*attributes));
+  case Token::forTok:
+  case Token::pforTok:
+    return parseFor(m_tree.makeList(*attributes));
+  default:
+    llvm::errs() << "Expected a loop after loop attributes.\n";
+    return {};
+  }
+}
+
+std::optional<lineRef> Parser::parseWhile(ArenaList<Attribute> t_attributes) {
   // parse 'while'
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
   // parse condition
   auto condition = parseExpression();
@@ -178,13 +403,20 @@ std::optional<linePtr> Parser::parseWhile() {
     return {};
   }
 
-  return std::make_unique<WhileAST>(m_genData, std::move(*condition),
-                                    std::move(*block));
+  return m_tree.addWhile(*condition, *block, t_attributes);
 }
 
-std::optional<linePtr> Parser::parseFor() {
-  // parse 'for'
-  m_lexer->nextToken();
+std::optional<lineRef> Parser::parseFor(ArenaList<Attribute> t_attributes) {
+  // parse 'for' or 'pfor'
+  if (m_tokens.getTok() == Token::pforTok) {
+    std::vector<Attribute> attributes;
+    for (const Attribute &attribute : m_tree.items(t_attributes)) {
+      attributes.push_back(attribute);
+    }
+    attributes.push_back({AttributeKind::parallel, 0});
+    t_attributes = m_tree.makeList(attributes);
+  }
+  m_tokens.nextToken();
 
   // parse initialization
   auto initialization = parseInner();
@@ -198,12 +430,12 @@ std::optional<linePtr> Parser::parseFor() {
     return {};
   }
 
-  if (m_lexer->getChar() != ';') {
+  if (m_tokens.getChar() != ';') {
     llvm::errs() << "Expected ';' in for loop.\n";
     return {};
   }
   // eat semicolon
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
   // parse updation
   auto updation = parseInner();
@@ -217,27 +449,45 @@ std::optional<linePtr> Parser::parseFor() {
     return {};
   }
 
-  return std::make_unique<ForAST>(m_genData, std::move(*initialization),
-                                  std::move(*condition), std::move(*updation),
-                                  std::move(*block));
+  return m_tree.addFor(*initialization, *condition, *updation, *block,
+                       t_attributes);
 }
 
-std::optional<linePtr> Parser::parseDecl() {
-  // eat 'let'
-  m_lexer->nextToken();
+std::optional<lineRef> Parser::parseDecl() {
+  // eat 'let' or 'const'
+  bool constant = m_tokens.getTok() == Token::constTok;
+  m_tokens.nextToken();
 
   // variable name
-  if (m_lexer->getTok() != Token::identifier) {
+  if (m_tokens.getTok() != Token::identifier) {
     llvm::errs() << "Expected identifier\n";
   }
 
-  std::string varName = m_lexer->getIdentifier();
-  m_lexer->nextToken();
+  Symbol varName = m_tokens.getSymbol();
+  m_tokens.nextToken();
+
+  // the type is inferred from the value if there's no annotation
+  ValueType type = ValueType::unknown;
+  uint32_t length = 0;
+  if (m_tokens.getOpCode() == OpCode::colon) {
+    m_tokens.nextToken();
+    auto annotation = parseType(&length);
+    if (!annotation) {
+      return {};
+    }
+    type = *annotation;
+  }
+
+  std::optional<expressionRef> value = {};
 
-  std::optional<expressionPtr> value = {};
+  if (m_tokens.getOpCode() == OpCode::assign) {
+    m_tokens.nextToken();
 
-  if (m_lexer->getOperation() == "=") {
-    m_lexer->nextToken();
+    // fixed-size arrays always start filled with zeros
+    if (length) {
+      llvm::errs() << "Fixed-size arrays can't be given a value.\n";
+      return {};
+    }
 
     value = parseExpression();
     if (!value) {
@@ -245,31 +495,46 @@ std::optional<linePtr> Parser::parseDecl() {
     }
   }
 
-  return std::make_unique<DeclarationAST>(m_genData, varName, std::move(value));
+  if (!constant) {
+    return m_tree.addDeclaration(varName, value.value_or(expressionRef()), type,
+                                 length);
+  }
+  if (!value) {
+    llvm::errs() << "Expected a value for constant '"
+                 << symbols().getName(varName) << "'.\n";
+    return {};
+  }
+  return m_tree.addDeclaration(
+      varName, *value, type, 0,
+      m_tree.makeList(std::vector<Attribute>{{AttributeKind::constant, 0}}));
 }
 
 // helper function for parseMain to parse the last character when the token is
 // unknown
-std::optional<expressionPtr> Parser::handleUnknown() {
-  switch (m_lexer->getChar()) {
+std::optional<expressionRef> Parser::handleUnknown() {
+  switch (m_tokens.getChar()) {
   case '(':
     return parseParens();
   case ';':
-    m_lexer->nextToken();
+    m_tokens.nextToken();
     return parseMainExpr();
   default:
-    llvm::errs() << "Unknown token: " << m_lexer->getChar() << '\n';
+    llvm::errs() << "Unknown token: " << m_lexer->getText(m_tokens.getSpan())
+                 << '\n';
     return {};
   }
 }
 
 // parse one "element" of an expression
-std::optional<expressionPtr> Parser::parseMainExpr() {
-  switch (m_lexer->getTok()) {
+std::optional<expressionRef> Parser::parseMainExpr() {
+  switch (m_tokens.getTok()) {
   case Token::identifier:
     return parseIdentifier();
   case Token::number:
     return parseNum();
+  case Token::trueTok:
+  case Token::falseTok:
+    return parseBool();
   case Token::ifTok:
     llvm::errs() << "Unexpected conditional statement in expression.\n";
     return {};
@@ -284,15 +549,16 @@ std::optional<expressionPtr> Parser::parseMainExpr() {
   }
 }
 
-std::optional<expressionPtr> Parser::parseOpRHS(const int t_minPrec,
-                                                expressionPtr t_leftSide) {
+std::optional<expressionRef> Parser::parseOpRHS(const int t_minPrec,
+                                                expressionRef t_leftSide) {
   while (true) {
     // parse operation
-    auto op = getBinOp(m_lexer->getOperation());
+    OpCode opCode = m_tokens.getOpCode();
+    auto op = getBinOp(opCode);
     if (!op) {
       return t_leftSide;
     }
-    m_lexer->nextToken();
+    m_tokens.nextToken();
 
     // if it is lower precedence, then it will be parsed in a different call
     if (op->precedence < t_minPrec) {
@@ -306,135 +572,169 @@ std::optional<expressionPtr> Parser::parseOpRHS(const int t_minPrec,
     }
 
     // if the expression continues, parse it
-    auto nextOp = getBinOp(m_lexer->getOperation());
+    auto nextOp = getBinOp(m_tokens.getOpCode());
     if (!nextOp.has_value()) {
-      return std::make_unique<BinaryOpAST>(
-          m_genData, *op, std::move(t_leftSide), std::move(*rightSide));
+      return m_tree.addBinaryOp(opCode, t_leftSide, *rightSide);
     }
     // if the next operator is higher precedence, it needs to be handled
     // before this one parse recursively
 
     if (op->precedence < nextOp->precedence) {
-      rightSide = parseOpRHS(op->precedence + 1, std::move(*rightSide));
+      rightSide = parseOpRHS(op->precedence + 1, *rightSide);
       if (!rightSide) {
         return {};
       }
     }
 
-    t_leftSide = std::make_unique<BinaryOpAST>(
-        m_genData, *op, std::move(t_leftSide), std::move(*rightSide));
+    t_leftSide = m_tree.addBinaryOp(opCode, t_leftSide, *rightSide);
   }
 }
 
-std::optional<expressionPtr> Parser::parseExpression() {
+std::optional<expressionRef> Parser::parseExpression() {
   auto leftSide = parseMainExpr();
   if (!leftSide) {
     return {};
   }
-  return parseOpRHS(0, std::move(*leftSide));
+  return parseOpRHS(0, *leftSide);
 }
 
-std::optional<std::unique_ptr<PrototypeAST>> Parser::parsePrototype() {
-  if (m_lexer->getTok() != Token::identifier) {
+std::optional<nodeRef>
+Parser::parsePrototype(ArenaList<Attribute> t_attributes) {
+  if (m_tokens.getTok() != Token::identifier) {
     llvm::errs() << "Expected function name in prototype.\n";
     return {};
   }
 
   // function name
-  std::string funcName = m_lexer->getIdentifier();
-  m_lexer->nextToken();
+  Symbol funcName = m_tokens.getSymbol();
+  m_tokens.nextToken();
 
   // arguments
-  if (m_lexer->getChar() != '(') {
+  if (m_tokens.getChar() != '(') {
     llvm::errs() << "Expected '('\n";
     return {};
   }
-  m_lexer->nextToken();
-  std::vector<std::string> args;
-  while (m_lexer->getChar() != ')') {
+  m_tokens.nextToken();
+  std::vector<Parameter> args;
+  while (m_tokens.getChar() != ')') {
     // parse argument
-    if (m_lexer->getTok() != Token::identifier) {
+    if (m_tokens.getTok() != Token::identifier) {
       llvm::errs() << "Unexpected token in prototype\n";
       return {};
     }
-    args.push_back(m_lexer->getIdentifier());
+    Parameter arg = {m_tokens.getSymbol(), ValueType::f64};
+    m_tokens.nextToken();
+
+    // parameters without a type are f64
+    if (m_tokens.getOpCode() == OpCode::colon) {
+      m_tokens.nextToken();
+      auto type = parseType();
+      if (!type) {
+        return {};
+      }
+      arg.m_type = *type;
+    }
+    args.push_back(arg);
 
     // end of arg list
-    m_lexer->nextToken();
-    if (m_lexer->getChar() == ')') {
+    if (m_tokens.getChar() == ')') {
       break;
     }
 
     // separator
-    if (m_lexer->getChar() != ',') {
+    if (m_tokens.getChar() != ',') {
       llvm::errs() << "Expected ')' or ',' in parameter list.\n";
       return {};
     }
-    m_lexer->nextToken();
+    m_tokens.nextToken();
   }
 
   // parse ')'
-  if (m_lexer->getChar() != ')') {
+  if (m_tokens.getChar() != ')') {
     llvm::errs() << "Expected ')'\n";
     return {};
   }
-  m_lexer->nextToken();
+  m_tokens.nextToken();
+
+  // so is the return type
+  ValueType returnType = ValueType::f64;
+  if (m_tokens.getOpCode() == OpCode::arrow) {
+    m_tokens.nextToken();
+    auto type = parseType();
+    if (!type) {
+      return {};
+    }
+    returnType = *type;
+  }
 
-  return std::make_unique<PrototypeAST>(m_genData, funcName, std::move(args));
+  return m_tree.addPrototype(funcName, m_tree.makeList(args), returnType,
+                             t_attributes);
 }
 
-std::optional<linePtr> Parser::parseReturn() {
+std::optional<lineRef> Parser::parseReturn() {
   // parse "ret"
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
   if (auto resAST = parseExpression()) {
-    return std::make_unique<ReturnAST>(m_genData, std::move(*resAST));
+    return m_tree.addReturn(*resAST);
   }
   return {};
 }
 
-std::optional<std::unique_ptr<FunctionAST>> Parser::parseDefinition() {
+std::optional<nodeRef>
+Parser::parseDefinition(ArenaList<Attribute> t_attributes) {
   // function declaration
-  m_lexer->nextToken();
+  m_tokens.nextToken();
 
   // prototype
-  auto prototype = parsePrototype();
+  auto prototype = parsePrototype(t_attributes);
   if (!prototype) {
     return {};
   }
 
   // body
   if (auto block = parseBlock()) {
-    return std::make_unique<FunctionAST>(m_genData, std::move(*prototype),
-                                         std::move(*block));
+    return m_tree.addFunction(*prototype, *block);
   }
 
   return {};
 }
 
-std::optional<std::unique_ptr<PrototypeAST>> Parser::parseExtern() {
-  m_lexer->nextToken();
-  return parsePrototype();
+std::optional<nodeRef> Parser::parseExtern(ArenaList<Attribute> t_attributes) {
+  m_tokens.nextToken();
+  return parsePrototype(t_attributes);
+}
+
+bool Parser::parseImport() {
+  m_tokens.nextToken();
+  if (m_tokens.getTok() != Token::identifier) {
+    llvm::errs() << "Expected a module name after 'import'.\n";
+    return false;
+  }
+  m_tree.addImport(m_tokens.getSymbol());
+  m_tokens.nextToken();
+  return true;
 }
 
 // wrap top-level expressions in an anonymous prototype
-std::optional<std::unique_ptr<FunctionAST>> Parser::parseTopLevel() {
+std::optional<nodeRef> Parser::parseTopLevel() {
   if (auto line = parseInner()) {
-    auto prototype = std::make_unique<PrototypeAST>(
-        m_genData,
-        "somethingThatIllProbablyForgetToChange", // Don't forget to change this
-        std::vector<std::string>());
-    blockPtr block;
-    block.push_back(std::move(*line));
-    return std::make_unique<FunctionAST>(m_genData, std::move(prototype),
-                                         std::move(block));
+    // Don't forget to change this
+    auto prototype = m_tree.addPrototype(
+        symbols().intern("somethingThatIllProbablyForgetToChange"),
+        ArenaList<Parameter>(), ValueType::f64);
+    return m_tree.addFunction(prototype, m_tree.makeList(std::vector{*line}));
   }
   return {};
 }
 
 // parse inner lines such as conditionals, returns and expressions
-std::optional<linePtr> Parser::parseInner() {
-  switch (m_lexer->getTok()) {
+std::optional<lineRef> Parser::parseInner() {
+  if (m_tokens.getChar() == '@') {
+    return parseLoop();
+  }
+
+  switch (m_tokens.getTok()) {
   case Token::ifTok:
     return parseConditional();
   case Token::returnTok:
@@ -442,8 +742,10 @@ std::optional<linePtr> Parser::parseInner() {
   case Token::whileTok:
     return parseWhile();
   case Token::forTok:
+  case Token::pforTok:
     return parseFor();
   case Token::letTok:
+  case Token::constTok:
     return parseDecl();
   case Token::elifTok:
     llvm::errs() << "Got 'elif' with no 'if' to match.\n";
@@ -457,30 +759,56 @@ std::optional<linePtr> Parser::parseInner() {
 
 // parses outer-level expressions such as functions and externs
 ParserStatus Parser::parseOuter() {
-  switch (m_lexer->getTok()) {
+  // attributes of the function that follows, like "@inline"
+  std::vector<Attribute> attributes;
+  if (m_tokens.getChar() == '@') {
+    auto parsed = parseAttributes(true);
+    if (!parsed) {
+      return ParserStatus::error;
+    }
+    attributes = std::move(*parsed);
+    Token tok = m_tokens.getTok();
+    if (tok != Token::func && tok != Token::constTok &&
+        tok != Token::externTok) {
+      llvm::errs() << "Expected a function after function attributes.\n";
+      return ParserStatus::error;
+    }
+  }
+
+  switch (m_tokens.getTok()) {
   case Token::endFile: {
     return ParserStatus::end;
   }
+  case Token::constTok:
+    // const fn, which can be evaluated while compiling
+    m_tokens.nextToken();
+    if (m_tokens.getTok() != Token::func) {
+      llvm::errs() << "Expected 'fn' after 'const'.\n";
+      return ParserStatus::error;
+    }
+    attributes.push_back({AttributeKind::constant, 0});
+    [[fallthrough]];
   case Token::func: {
-    auto resAST = parseDefinition();
+    auto resAST = parseDefinition(m_tree.makeList(attributes));
     if (!resAST) {
       return ParserStatus::error;
     }
-    if ((*resAST)->codegen()) {
-      return ParserStatus::ok;
-    }
-    return ParserStatus::error;
+    m_tree.addItem(*resAST);
+    return ParserStatus::ok;
   }
   case Token::externTok: {
-    auto resAST = parseExtern();
-    if ((*resAST)->codegen()) {
-      return ParserStatus::ok;
+    auto resAST = parseExtern(m_tree.makeList(attributes));
+    if (!resAST) {
+      return ParserStatus::error;
     }
-    return ParserStatus::error;
+    m_tree.addItem(*resAST);
+    return ParserStatus::ok;
   }
+  case Token::importTok:
+    return parseImport() ? ParserStatus::ok : ParserStatus::error;
   default: {
-    if (m_lexer->getChar() == ';') {
-      m_lexer->nextToken();
+    if (m_tokens.getChar() == ';') {
+      m_tokens.nextToken();
       return ParserStatus::ok;
     }
     return ParserStatus::error;
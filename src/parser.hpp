@@ -2,7 +2,9 @@
 #define BEAVER_PARSER_HPP
 
 #include "lexer.hpp"
+#include "operations.hpp"
 #include "syntaxtree.hpp"
+#include "llvm/Support/raw_ostream.h"
 #include <cctype>
 #include <iostream>
 
@@ -13,45 +15,63 @@ enum class ParserStatus { ok, end, error };
 // Uses the lexer to parse the file into an AST
 class Parser {
 private:
-  // Stored lexer
+  // Stored lexer, kept for the source text and diagnostics
   std::unique_ptr<Lexer> m_lexer;
 
-  // Stores a generator to pass it to code generation
-  std::shared_ptr<Generator> m_genData;
+  // the lexed file
+  TokenStream m_tokens;
+
+  // owns every node built by this parser
+  SyntaxTree m_tree;
 
   // Parse functions for various parts of the syntax
-  std::optional<blockPtr> parseBlock();
-  std::optional<expressionPtr> parseNum();
-  std::optional<expressionPtr> parseExpression();
-  std::optional<expressionPtr> parseParens();
-  std::optional<expressionPtr> parseCall(std::string idName);
-  std::optional<expressionPtr> parseIdentifier();
+  std::optional<blockRef> parseBlock();
+  std::optional<expressionRef> parseNum();
+  std::optional<expressionRef> parseBool();
+  std::optional<ValueType> parseType(uint32_t *t_length = nullptr);
+  std::optional<expressionRef> parseExpression();
+  std::optional<expressionRef> parseParens();
+  std::optional<expressionRef> parseCall(Symbol t_callee);
+  std::optional<expressionRef> parseIndex(expressionRef t_array);
+  std::optional<expressionRef> parseIdentifier();
   // returns 0 iff the block was successfully parsed
-  bool parseConditionalBlock(std::vector<blockPtr> &mainBlocks,
-                             std::vector<expressionPtr> &conditions);
-  std::optional<linePtr> parseConditional();
-  std::optional<linePtr> parseWhile();
-  std::optional<linePtr> parseFor();
-  std::optional<linePtr> parseDecl();
-  std::optional<expressionPtr> handleUnknown();
-  std::optional<expressionPtr> parseMainExpr();
-  std::optional<expressionPtr> parseOpRHS(const int t_minPrec,
-                                          expressionPtr t_leftSide);
-  std::optional<std::unique_ptr<PrototypeAST>> parsePrototype();
-  std::optional<linePtr> parseReturn();
-  std::optional<std::unique_ptr<FunctionAST>> parseDefinition();
-  std::optional<std::unique_ptr<PrototypeAST>> parseExtern();
-  std::optional<std::unique_ptr<FunctionAST>> parseTopLevel();
-  std::optional<linePtr> parseInner();
+  bool parseConditionalBlock(std::vector<blockRef> &mainBlocks,
+                             std::vector<expressionRef> &conditions);
+  std::optional<lineRef> parseConditional();
+  // attributes of a function if t_function is set, or else of a loop
+  std::optional<std::vector<Attribute>> parseAttributes(bool t_function);
+  std::optional<lineRef> parseLoop();
+  std::optional<lineRef> parseWhile(ArenaList<Attribute> t_attributes = {});
+  std::optional<lineRef> parseFor(ArenaList<Attribute> t_attributes = {});
+  std::optional<lineRef> parseDecl();
+  std::optional<expressionRef> handleUnknown();
+  std::optional<expressionRef> parseMainExpr();
+  std::optional<expressionRef> parseOpRHS(const int t_minPrec,
+                                          expressionRef t_leftSide);
+  std::optional<nodeRef> parsePrototype(ArenaList<Attribute> t_attributes = {});
+  std::optional<lineRef> parseReturn();
+  std::optional<nodeRef>
+  parseDefinition(ArenaList<Attribute> t_attributes = {});
+  std::optional<nodeRef> parseExtern(ArenaList<Attribute> t_attributes = {});
+  // import name, whose functions are added by the driver
+  bool parseImport();
+  std::optional<nodeRef> parseTopLevel();
+  std::optional<lineRef> parseInner();
 
 public:
-  Parser(std::unique_ptr<Lexer> t_lexer, std::shared_ptr<Generator> t_genData)
-      : m_lexer(std::move(t_lexer)), m_genData(t_genData) {
-    m_lexer->nextToken();
-  }
+  Parser(std::unique_ptr<Lexer> t_lexer)
+      : m_lexer(std::move(t_lexer)), m_tokens(m_lexer->tokenize()) {}
+
+  // for a file that has already been lexed, possibly on another thread
+  Parser(std::unique_ptr<Lexer> t_lexer, TokenBuffer t_tokens)
+      : m_lexer(std::move(t_lexer)), m_tokens(std::move(t_tokens)) {}
   ~Parser() = default;
 
+  // parses one outer-level item and adds it to the tree
   ParserStatus parseOuter();
+
+  const SyntaxTree &getTree() const { return m_tree; }
+  SyntaxTree &getTree() { return m_tree; }
 };
 
 #endif // BEAVER_PARSER_HPP
\ No newline at end of file
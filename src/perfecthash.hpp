@@ -0,0 +1,90 @@
+#ifndef BEAVER_PERFECTHASH_HPP
+#define BEAVER_PERFECTHASH_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+// Lookup table for a fixed set of strings, built at compile time
+// A seed is searched for so that no two keys share a slot, so a lookup is
+// one hash, one string comparison and no allocation
+template <typename Value, size_t N> class PerfectHash {
+private:
+  // at least twice as many slots as keys keeps the seed search short
+  static constexpr size_t tableSize() {
+    size_t size = 1;
+    while (size < 2 * N) {
+      size *= 2;
+    }
+    return size;
+  }
+
+  struct Slot {
+    std::string_view key = {};
+    Value value = {};
+    bool used = false;
+  };
+
+  std::array<Slot, tableSize()> m_table = {};
+  uint32_t m_seed = 0;
+  bool m_valid = false;
+
+  // FNV-1a, with the seed mixed into the offset basis
+  // the low bits of FNV-1a only depend on the low bits of the seed, so the
+  // high bits are folded in to let every seed give a different table
+  static constexpr uint32_t hash(std::string_view t_key, uint32_t t_seed) {
+    uint32_t result = 2166136261u ^ (t_seed * 0x9E3779B9u);
+    for (char character : t_key) {
+      result ^= static_cast<unsigned char>(character);
+      result *= 16777619u;
+    }
+    return result ^ (result >> 16);
+  }
+
+  static constexpr size_t slotOf(std::string_view t_key, uint32_t t_seed) {
+    return hash(t_key, t_seed) & (tableSize() - 1);
+  }
+
+public:
+  constexpr PerfectHash(
+      const std::array<std::pair<std::string_view, Value>, N> &t_keys) {
+    for (uint32_t seed = 0; seed < 100000; ++seed) {
+      std::array<bool, tableSize()> taken = {};
+      bool collision = false;
+      for (size_t idx = 0; idx < N && !collision; ++idx) {
+        size_t slot = slotOf(t_keys[idx].first, seed);
+        collision = taken[slot];
+        taken[slot] = true;
+      }
+      if (collision) {
+        continue;
+      }
+
+      m_seed = seed;
+      for (size_t idx = 0; idx < N; ++idx) {
+        Slot &slot = m_table[slotOf(t_keys[idx].first, seed)];
+        slot.key = t_keys[idx].first;
+        slot.value = t_keys[idx].second;
+        slot.used = true;
+      }
+      m_valid = true;
+      return;
+    }
+  }
+
+  // whether a seed without collisions was found
+  constexpr bool isValid() const { return m_valid; }
+
+  constexpr std::optional<Value> find(std::string_view t_key) const {
+    const Slot &slot = m_table[slotOf(t_key, m_seed)];
+    if (!slot.used || slot.key != t_key) {
+      return {};
+    }
+    return slot.value;
+  }
+};
+
+#endif // BEAVER_PERFECTHASH_HPP
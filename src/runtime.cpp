@@ -0,0 +1,179 @@
+#include "runtime.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// one call to beaver_parallel_for
+struct Loop {
+  beaver_loop_body m_body;
+  void *m_context;
+  // ranges are split until they have at most this many iterations
+  int64_t m_grain;
+  // iterations that haven't finished, the loop is done at 0
+  std::atomic<int64_t> m_remaining;
+};
+
+// iterations of a loop that haven't started
+struct Task {
+  Loop *m_loop;
+  int64_t m_begin;
+  int64_t m_end;
+};
+
+// Runs loops on a fixed set of threads by work stealing
+// Every thread has a deque of tasks. A task splits its range in half until
+// it's small enough, leaving the upper halves at the back of the deque, and
+// a thread takes tasks from the back of its own deque and steals from the
+// front of the others when it runs out, so thieves take the largest ranges
+// Threads that start loops from outside share the first deque, and work on
+// tasks until their loop is done
+class Scheduler {
+private:
+  struct Queue {
+    std::mutex m_mutex;
+    std::deque<Task> m_tasks;
+  };
+  std::vector<std::unique_ptr<Queue>> m_queues;
+
+  // tasks in all the queues, which idle threads wait for
+  std::atomic<int64_t> m_queued{0};
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wake;
+
+  // the queue of the current thread
+  static thread_local unsigned s_queue;
+
+  void push(Task t_task) {
+    Queue &queue = *m_queues[s_queue];
+    {
+      std::lock_guard<std::mutex> lock(queue.m_mutex);
+      queue.m_tasks.push_back(t_task);
+      m_queued.fetch_add(1);
+    }
+    // taking the lock means a thread that's about to wait has either seen
+    // the task or is waiting already
+    { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+    m_wake.notify_one();
+  }
+
+  bool find(Task &t_task) {
+    // newest task of this thread
+    {
+      Queue &queue = *m_queues[s_queue];
+      std::lock_guard<std::mutex> lock(queue.m_mutex);
+      if (!queue.m_tasks.empty()) {
+        t_task = queue.m_tasks.back();
+        queue.m_tasks.pop_back();
+        m_queued.fetch_sub(1);
+        return true;
+      }
+    }
+    // oldest task of another one
+    for (size_t i = 1; i < m_queues.size(); ++i) {
+      Queue &queue = *m_queues[(s_queue + i) % m_queues.size()];
+      std::lock_guard<std::mutex> lock(queue.m_mutex);
+      if (!queue.m_tasks.empty()) {
+        t_task = queue.m_tasks.front();
+        queue.m_tasks.pop_front();
+        m_queued.fetch_sub(1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run(Task t_task) {
+    Loop &loop = *t_task.m_loop;
+    while (t_task.m_end - t_task.m_begin > loop.m_grain) {
+      int64_t middle = t_task.m_begin + (t_task.m_end - t_task.m_begin) / 2;
+      push({&loop, middle, t_task.m_end});
+      t_task.m_end = middle;
+    }
+    loop.m_body(loop.m_context, t_task.m_begin, t_task.m_end);
+    // the loop may be gone as soon as this reaches 0
+    loop.m_remaining.fetch_sub(t_task.m_end - t_task.m_begin,
+                               std::memory_order_acq_rel);
+  }
+
+  void work(unsigned t_queue) {
+    s_queue = t_queue;
+    Task task;
+    while (true) {
+      if (find(task)) {
+        run(task);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(m_sleepMutex);
+      m_wake.wait(lock, [this] { return m_queued.load() > 0; });
+    }
+  }
+
+public:
+  Scheduler(unsigned t_threads) {
+    for (unsigned i = 0; i < t_threads; ++i) {
+      m_queues.push_back(std::make_unique<Queue>());
+    }
+    // the threads are never stopped, so a program can exit from any of them
+    for (unsigned i = 1; i < t_threads; ++i) {
+      std::thread([this, i] { work(i); }).detach();
+    }
+  }
+
+  size_t getThreads() const { return m_queues.size(); }
+
+  void parallelFor(int64_t t_begin, int64_t t_end, beaver_loop_body t_body,
+                   void *t_context) {
+    // a few chunks per thread, so threads that finish early can help
+    int64_t count = t_end - t_begin;
+    Loop loop{t_body, t_context,
+              std::max<int64_t>(1, count / (getThreads() * 8)), count};
+    run({&loop, t_begin, t_end});
+
+    // the rest of the loop may be waiting in this thread's queue, so this
+    // thread keeps working, even on other loops, until it's done
+    Task task;
+    while (loop.m_remaining.load(std::memory_order_acquire) > 0) {
+      if (find(task)) {
+        run(task);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+thread_local unsigned Scheduler::s_queue = 0;
+
+unsigned getThreadCount() {
+  if (const char *threads = std::getenv("BEAVER_THREADS")) {
+    int count = std::atoi(threads);
+    if (count > 0) {
+      return count;
+    }
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+} // namespace
+
+extern "C" void beaver_parallel_for(int64_t t_begin, int64_t t_end,
+                                    beaver_loop_body t_body, void *t_context) {
+  if (t_end <= t_begin) {
+    return;
+  }
+  // made on first use and never destroyed, since its threads don't stop
+  static Scheduler *scheduler = new Scheduler(getThreadCount());
+  if (scheduler->getThreads() == 1) {
+    t_body(t_context, t_begin, t_end);
+    return;
+  }
+  scheduler->parallelFor(t_begin, t_end, t_body, t_context);
+}
@@ -0,0 +1,24 @@
+#ifndef BEAVER_RUNTIME_HPP
+#define BEAVER_RUNTIME_HPP
+
+#include <cstdint>
+
+// Functions that generated code calls
+// The JIT finds them in the compiler, and programs compiled ahead of time
+// link the beaverrt library
+// Their names have underscores, which beaver names can't, so they never clash
+// with a beaver function
+extern "C" {
+
+// the body of a pfor loop, which runs the iterations from t_begin to t_end
+using beaver_loop_body = void (*)(void *t_context, int64_t t_begin,
+                                  int64_t t_end);
+
+// run the iterations from t_begin to t_end on every core, in chunks, and
+// return once they're all done
+// the number of threads is the number of cores, or BEAVER_THREADS if it's set
+void beaver_parallel_for(int64_t t_begin, int64_t t_end,
+                         beaver_loop_body t_body, void *t_context);
+}
+
+#endif // BEAVER_RUNTIME_HPP
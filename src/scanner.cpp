@@ -0,0 +1,205 @@
+#include "scanner.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define BEAVER_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace scanner {
+namespace {
+
+// Scalar versions
+// These are used on targets without a vector implementation, and to finish
+// the last few bytes of the buffer that don't fill a whole vector
+
+template <uint8_t Class>
+const char *skipClassScalar(const char *t_begin, const char *t_end) {
+  while (t_begin != t_end && hasClass(*t_begin, Class)) {
+    ++t_begin;
+  }
+  return t_begin;
+}
+
+const char *skipWhitespaceScalar(const char *t_begin, const char *t_end) {
+  return skipClassScalar<space>(t_begin, t_end);
+}
+
+const char *skipIdentifierScalar(const char *t_begin, const char *t_end) {
+  return skipClassScalar<alpha | digit>(t_begin, t_end);
+}
+
+const char *findLineEndScalar(const char *t_begin, const char *t_end) {
+  while (t_begin != t_end && !hasClass(*t_begin, lineEnd)) {
+    ++t_begin;
+  }
+  return t_begin;
+}
+
+#ifdef BEAVER_SCANNER_X86
+
+// SSE2 is part of the x86-64 baseline, so these need no runtime check
+
+// mask of bytes in [lo, hi], compared as unsigned
+inline __m128i inRange128(__m128i t_bytes, char t_low, char t_high) {
+  __m128i shifted = _mm_sub_epi8(t_bytes, _mm_set1_epi8(t_low));
+  __m128i bound = _mm_set1_epi8(static_cast<char>(t_high - t_low));
+  return _mm_cmpeq_epi8(_mm_min_epu8(shifted, bound), shifted);
+}
+
+inline __m128i whitespace128(__m128i t_bytes) {
+  return _mm_or_si128(_mm_cmpeq_epi8(t_bytes, _mm_set1_epi8(' ')),
+                      inRange128(t_bytes, '\t', '\r'));
+}
+
+inline __m128i identifier128(__m128i t_bytes) {
+  // setting bit 5 maps uppercase letters onto lowercase ones
+  __m128i lower = _mm_or_si128(t_bytes, _mm_set1_epi8(0x20));
+  return _mm_or_si128(inRange128(lower, 'a', 'z'),
+                      inRange128(t_bytes, '0', '9'));
+}
+
+inline __m128i lineEnd128(__m128i t_bytes) {
+  return _mm_or_si128(_mm_cmpeq_epi8(t_bytes, _mm_set1_epi8('\n')),
+                      _mm_cmpeq_epi8(t_bytes, _mm_set1_epi8('\r')));
+}
+
+inline __m128i load128(const char *t_position) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(t_position));
+}
+
+const char *skipWhitespaceSSE2(const char *t_begin, const char *t_end) {
+  // most runs are a single space, so don't bother with the vector setup
+  if (t_begin == t_end || !isSpace(*t_begin)) {
+    return t_begin;
+  }
+  while (t_end - t_begin >= 16) {
+    int matches = _mm_movemask_epi8(whitespace128(load128(t_begin)));
+    unsigned mask = matches ^ 0xFFFF;
+    if (mask) {
+      return t_begin + __builtin_ctz(mask);
+    }
+    t_begin += 16;
+  }
+  return skipWhitespaceScalar(t_begin, t_end);
+}
+
+const char *skipIdentifierSSE2(const char *t_begin, const char *t_end) {
+  while (t_end - t_begin >= 16) {
+    int matches = _mm_movemask_epi8(identifier128(load128(t_begin)));
+    unsigned mask = matches ^ 0xFFFF;
+    if (mask) {
+      return t_begin + __builtin_ctz(mask);
+    }
+    t_begin += 16;
+  }
+  return skipIdentifierScalar(t_begin, t_end);
+}
+
+const char *findLineEndSSE2(const char *t_begin, const char *t_end) {
+  while (t_end - t_begin >= 16) {
+    unsigned mask = _mm_movemask_epi8(lineEnd128(load128(t_begin)));
+    if (mask) {
+      return t_begin + __builtin_ctz(mask);
+    }
+    t_begin += 16;
+  }
+  return findLineEndScalar(t_begin, t_end);
+}
+
+// AVX2 versions, only used if the CPU reports support for it
+
+#define BEAVER_AVX2 __attribute__((target("avx2")))
+
+BEAVER_AVX2 inline __m256i inRange256(__m256i t_bytes, char t_low,
+                                      char t_high) {
+  __m256i shifted = _mm256_sub_epi8(t_bytes, _mm256_set1_epi8(t_low));
+  __m256i bound = _mm256_set1_epi8(static_cast<char>(t_high - t_low));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, bound), shifted);
+}
+
+BEAVER_AVX2 inline __m256i whitespace256(__m256i t_bytes) {
+  return _mm256_or_si256(_mm256_cmpeq_epi8(t_bytes, _mm256_set1_epi8(' ')),
+                         inRange256(t_bytes, '\t', '\r'));
+}
+
+BEAVER_AVX2 inline __m256i identifier256(__m256i t_bytes) {
+  __m256i lower = _mm256_or_si256(t_bytes, _mm256_set1_epi8(0x20));
+  return _mm256_or_si256(inRange256(lower, 'a', 'z'),
+                         inRange256(t_bytes, '0', '9'));
+}
+
+BEAVER_AVX2 inline __m256i lineEnd256(__m256i t_bytes) {
+  return _mm256_or_si256(_mm256_cmpeq_epi8(t_bytes, _mm256_set1_epi8('\n')),
+                         _mm256_cmpeq_epi8(t_bytes, _mm256_set1_epi8('\r')));
+}
+
+BEAVER_AVX2 inline __m256i load256(const char *t_position) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(t_position));
+}
+
+BEAVER_AVX2 const char *skipWhitespaceAVX2(const char *t_begin,
+                                           const char *t_end) {
+  if (t_begin == t_end || !isSpace(*t_begin)) {
+    return t_begin;
+  }
+  while (t_end - t_begin >= 32) {
+    unsigned mask = ~static_cast<unsigned>(
+        _mm256_movemask_epi8(whitespace256(load256(t_begin))));
+    if (mask) {
+      return t_begin + __builtin_ctz(mask);
+    }
+    t_begin += 32;
+  }
+  return skipWhitespaceSSE2(t_begin, t_end);
+}
+
+BEAVER_AVX2 const char *skipIdentifierAVX2(const char *t_begin,
+                                           const char *t_end) {
+  while (t_end - t_begin >= 32) {
+    unsigned mask = ~static_cast<unsigned>(
+        _mm256_movemask_epi8(identifier256(load256(t_begin))));
+    if (mask) {
+      return t_begin + __builtin_ctz(mask);
+    }
+    t_begin += 32;
+  }
+  return skipIdentifierSSE2(t_begin, t_end);
+}
+
+BEAVER_AVX2 const char *findLineEndAVX2(const char *t_begin,
+                                        const char *t_end) {
+  while (t_end - t_begin >= 32) {
+    unsigned mask = static_cast<unsigned>(
+        _mm256_movemask_epi8(lineEnd256(load256(t_begin))));
+    if (mask) {
+      return t_begin + __builtin_ctz(mask);
+    }
+    t_begin += 32;
+  }
+  return findLineEndSSE2(t_begin, t_end);
+}
+
+#undef BEAVER_AVX2
+
+#endif // BEAVER_SCANNER_X86
+
+ScanFunctions selectFunctions() {
+#ifdef BEAVER_SCANNER_X86
+  // this runs during static initialization, possibly before the runtime has
+  // filled in the CPU information
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {skipWhitespaceAVX2, skipIdentifierAVX2, findLineEndAVX2, "avx2"};
+  }
+  return {skipWhitespaceSSE2, skipIdentifierSSE2, findLineEndSSE2, "sse2"};
+#else
+  return {skipWhitespaceScalar, skipIdentifierScalar, findLineEndScalar,
+          "scalar"};
+#endif
+}
+
+} // namespace
+
+const ScanFunctions functions = selectFunctions();
+
+} // namespace scanner
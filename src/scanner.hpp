@@ -0,0 +1,81 @@
+#ifndef BEAVER_SCANNER_HPP
+#define BEAVER_SCANNER_HPP
+
+#include <array>
+#include <cstdint>
+
+// Character classification and bulk scanning helpers for the lexer
+// The bulk functions process 16 or 32 bytes per step when SSE2 or AVX2 is
+// available, and the implementation is picked once at startup
+namespace scanner {
+
+// character classes
+enum CharClass : uint8_t {
+  space = 1 << 0,
+  alpha = 1 << 1,
+  digit = 1 << 2,
+  lineEnd = 1 << 3
+};
+
+// table of classes for every byte, independent of the locale
+constexpr std::array<uint8_t, 256> makeClassTable() {
+  std::array<uint8_t, 256> table = {};
+  for (unsigned c = '\t'; c <= '\r'; ++c) {
+    table[c] |= space;
+  }
+  table[' '] |= space;
+  table['\n'] |= lineEnd;
+  table['\r'] |= lineEnd;
+  for (unsigned c = 'a'; c <= 'z'; ++c) {
+    table[c] |= alpha;
+    table[c - 'a' + 'A'] |= alpha;
+  }
+  for (unsigned c = '0'; c <= '9'; ++c) {
+    table[c] |= digit;
+  }
+  return table;
+}
+
+constexpr std::array<uint8_t, 256> classTable = makeClassTable();
+
+inline bool hasClass(char t_character, uint8_t t_class) {
+  return classTable[static_cast<unsigned char>(t_character)] & t_class;
+}
+inline bool isSpace(char t_character) { return hasClass(t_character, space); }
+inline bool isAlpha(char t_character) { return hasClass(t_character, alpha); }
+inline bool isDigit(char t_character) { return hasClass(t_character, digit); }
+inline bool isAlnum(char t_character) {
+  return hasClass(t_character, alpha | digit);
+}
+
+// Implementations of the bulk scanning functions
+// Each one returns the first position in [t_begin, t_end) that doesn't
+// belong to the scanned run, or t_end
+struct ScanFunctions {
+  const char *(*skipWhitespace)(const char *t_begin, const char *t_end);
+  const char *(*skipIdentifier)(const char *t_begin, const char *t_end);
+  const char *(*findLineEnd)(const char *t_begin, const char *t_end);
+  const char *name;
+};
+
+// the implementation chosen for the current CPU
+extern const ScanFunctions functions;
+
+// skips [ \t\n\v\f\r]*
+inline const char *skipWhitespace(const char *t_begin, const char *t_end) {
+  return functions.skipWhitespace(t_begin, t_end);
+}
+
+// skips [A-z0-9]*
+inline const char *skipIdentifier(const char *t_begin, const char *t_end) {
+  return functions.skipIdentifier(t_begin, t_end);
+}
+
+// finds the next '\n' or '\r'
+inline const char *findLineEnd(const char *t_begin, const char *t_end) {
+  return functions.findLineEnd(t_begin, t_end);
+}
+
+} // namespace scanner
+
+#endif // BEAVER_SCANNER_HPP
@@ -0,0 +1,33 @@
+#include "symboltable.hpp"
+#include <mutex>
+
+Symbol SymbolTable::intern(std::string_view t_name) {
+  {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto lookup = m_ids.find(t_name);
+    if (lookup != m_ids.end()) {
+      return lookup->second;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
+  // another thread may have added it in the meantime
+  auto lookup = m_ids.find(t_name);
+  if (lookup != m_ids.end()) {
+    return lookup->second;
+  }
+  Symbol result = m_names.size();
+  const std::string &name = m_names.emplace_back(t_name);
+  m_ids.emplace(name, result);
+  return result;
+}
+
+std::string_view SymbolTable::getName(Symbol t_symbol) const {
+  std::shared_lock<std::shared_mutex> lock(m_mutex);
+  return m_names[t_symbol];
+}
+
+SymbolTable &symbols() {
+  static SymbolTable table;
+  return table;
+}
@@ -0,0 +1,40 @@
+#ifndef BEAVER_SYMBOLTABLE_HPP
+#define BEAVER_SYMBOLTABLE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// interned identifier
+using Symbol = uint32_t;
+
+// Every distinct identifier is stored once and referred to by its Symbol, so
+// comparing or hashing names is an integer operation
+// Lexers on different threads can intern into the same table
+class SymbolTable {
+private:
+  mutable std::shared_mutex m_mutex;
+  // a deque never moves its elements, so views of the names stay valid
+  std::deque<std::string> m_names;
+  std::unordered_map<std::string_view, Symbol> m_ids;
+
+public:
+  SymbolTable() = default;
+  ~SymbolTable() = default;
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+
+  // returns the symbol for a name, adding it if it is new
+  Symbol intern(std::string_view t_name);
+
+  // the name of an interned symbol
+  std::string_view getName(Symbol t_symbol) const;
+};
+
+// the table shared by the whole compiler
+SymbolTable &symbols();
+
+#endif // BEAVER_SYMBOLTABLE_HPP
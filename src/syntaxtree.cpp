@@ -1,368 +1,162 @@
 #include "syntaxtree.hpp"
 
-std::optional<llvm::Value *> NumberAST::codegenE() {
-  return llvm::ConstantFP::get(m_generator->m_context, llvm::APFloat(m_value));
-};
-
-std::optional<llvm::Value *> VariableAST::codegenE() {
-  // search in named variables
-  llvm::AllocaInst *variable = m_generator->m_namedValues[m_name];
-  if (!variable) {
-    llvm::errs() << "Unknown variable name.\n";
-    return {};
-  }
-
-  return m_generator->m_builder.CreateLoad(variable->getAllocatedType(),
-                                           variable);
-};
-
-std::optional<llvm::Value *> BinaryOpAST::codegenE() {
-  std::optional<llvm::Value *> leftCode = m_lhs->codegenE();
-  std::optional<llvm::Value *> rightCode = m_rhs->codegenE();
-  if (!leftCode || !rightCode) {
-    return {};
-  }
-  return m_op.codegen(m_generator, *leftCode, *rightCode);
-};
-
-std::optional<llvm::Value *> AssignmentOpAST::codegenE() {
-  auto leftCode = m_generator->m_namedValues[m_lhs];
-  if (!leftCode) {
-    return {};
-  }
-
-  std::optional<llvm::Value *> rightCode = m_rhs->codegenE();
-  if (!rightCode) {
-    return {};
-  }
-
-  return m_op.codegen(m_generator, leftCode, *rightCode);
-};
-
-std::optional<llvm::Value *> CallAST::codegenE() {
-  // search for the function being called
-  llvm::Function *calledFunction = m_generator->m_module.getFunction(m_callee);
-  if (!calledFunction) {
-    std::cerr << "Unknown function\n";
-    return {};
-  }
-
-  // check for number of arguments
-  size_t numArgs = m_args.size();
-  if (calledFunction->arg_size() != numArgs) {
-    std::cerr << "Incorrect number of arguments\n";
-    return {};
-  }
-
-  // generate code for each argument
-  std::vector<llvm::Value *> argsCode(numArgs);
-  for (size_t i = 0; i < numArgs; ++i) {
-    std::optional<llvm::Value *> line = m_args[i]->codegenE();
-    if (!line) {
-      return {};
-    }
-    argsCode[i] = *line;
-  }
-
-  return m_generator->m_builder.CreateCall(calledFunction, argsCode);
-};
-
-GenStatus ConditionalAST::codegen() {
-  // create blocks
-  llvm::Function *functionCode =
-      m_generator->m_builder.GetInsertBlock()->getParent();
-
-  llvm::BasicBlock *mergedBB =
-      llvm::BasicBlock::Create(m_generator->m_context, "", functionCode);
-  llvm::BasicBlock *checkBB = m_generator->m_builder.GetInsertBlock();
-  llvm::BasicBlock *nextBB =
-      llvm::BasicBlock::Create(m_generator->m_context, "", functionCode);
-
-  unsigned numBlocks = m_conditions.size();
-  bool allTerminated = true;
-
-  for (unsigned i = 0; i < numBlocks; ++i) {
-    // condition
-    std::optional<llvm::Value *> conditionCode = m_conditions[i]->codegenE();
-    if (!conditionCode) {
-      return GenStatus::error;
-    }
-
-    // compare to 0
-    llvm::Value *comparisonCode = m_generator->m_builder.CreateFCmpONE(
-        *conditionCode,
-        llvm::ConstantFP::get(m_generator->m_context, llvm::APFloat(0.0)));
-
-    // create the block with the code
-    llvm::BasicBlock *codeBB =
-        llvm::BasicBlock::Create(m_generator->m_context, "", functionCode);
-
-    // create the conditional branch
-    m_generator->m_builder.CreateCondBr(comparisonCode, codeBB, nextBB);
-    m_generator->m_builder.SetInsertPoint(codeBB);
-
-    bool currTerminated = false;
-    for (auto &line : m_mainBlocks[i]) {
-      GenStatus mainResult = line->codegen();
-      if (mainResult == GenStatus::error) {
-        return GenStatus::error;
-      }
-      if (mainResult == GenStatus::terminated) { // only one terminator allowed
-        currTerminated = true;
-        break;
-      }
-    }
-
-    // after it's finished, go to the merged block
-    if (!currTerminated) {
-      allTerminated = false;
-      m_generator->m_builder.CreateBr(mergedBB);
-    }
-
-    checkBB = nextBB;
-
-    // I feel like there's a better way to do this...
-    if (i < numBlocks - 1) {
-      nextBB =
-          llvm::BasicBlock::Create(m_generator->m_context, "", functionCode);
-    }
-
-    m_generator->m_builder.SetInsertPoint(checkBB);
-  }
-
-  // checkBB is now the else block
-
-  // generate code for the else block
-  bool elseTerminated = false;
-  if (m_elseBlock) {
-    for (auto &line : *m_elseBlock) {
-      GenStatus elseResult = line->codegen();
-      if (elseResult == GenStatus::error) {
-        return GenStatus::error;
-      } else if (elseResult == GenStatus::terminated) {
-        elseTerminated = true;
-        break;
-      }
-    }
-  }
-
-  // go back to merged block
-  if (!elseTerminated) {
-    m_generator->m_builder.CreateBr(mergedBB);
-  }
-
-  // create merged block
-  if (!allTerminated || !elseTerminated) {
-    m_generator->m_builder.SetInsertPoint(mergedBB);
-  } else {
-    llvm::DeleteDeadBlock(mergedBB);
-    return GenStatus::terminated;
-  }
-  // placeholder. the structure will be changed soon
-  return GenStatus::ok;
+nodeRef SyntaxTree::add(Node t_node) {
+  nodeRef result(m_nodes.size());
+  m_nodes.push_back(t_node);
+
+  // the subtree starts where the earliest child subtree starts
+  uint32_t first = result.getId();
+  forEachChild(result, [&](nodeRef t_child) {
+    first = std::min(first, get(t_child).m_first);
+  });
+  m_nodes.back().m_first = first;
+
+  return result;
 }
 
-GenStatus WhileAST::codegen() {
-  // condition
-  std::optional<llvm::Value *> conditionCode = m_condition->codegenE();
-  if (!conditionCode) {
-    return {};
-  }
-
-  // compare to 0
-  llvm::Value *comparisonCode = m_generator->m_builder.CreateFCmpONE(
-      *conditionCode,
-      llvm::ConstantFP::get(m_generator->m_context, llvm::APFloat(0.0)));
-
-  // create blocks
-  llvm::Function *functionCode =
-      m_generator->m_builder.GetInsertBlock()->getParent();
-  llvm::BasicBlock *blockBB =
-      llvm::BasicBlock::Create(m_generator->m_context, "", functionCode);
-  llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(m_generator->m_context);
-
-  // create the conditional branch
-  m_generator->m_builder.CreateCondBr(comparisonCode, blockBB, afterBB);
-
-  m_generator->m_builder.SetInsertPoint(blockBB);
-
-  bool terminated = false;
-  for (auto &line : m_block) {
-    GenStatus lineResult = line->codegen();
-    if (lineResult != GenStatus::ok) {
-      return lineResult;
-    }
-  }
-
-  m_generator->m_builder.CreateCondBr(comparisonCode, blockBB, afterBB);
-  m_generator->m_builder.SetInsertPoint(afterBB);
-
-  return GenStatus::ok;
+expressionRef SyntaxTree::addNumber(double t_value, ValueType t_type) {
+  Node node(NodeKind::number);
+  node.m_number = t_value;
+  node.m_integer = t_type == ValueType::boolean && t_value != 0;
+  node.m_type = t_type;
+  return add(node);
 }
 
-GenStatus ForAST::codegen() {
-  // intialization
-  GenStatus initializationResult = m_initialization->codegen();
-  if (initializationResult != GenStatus::ok) {
-    return initializationResult;
-  }
-
-  // condition
-  std::optional<llvm::Value *> conditionCode = m_condition->codegenE();
-  if (!conditionCode) {
-    return {};
-  }
-
-  // compare to 0
-  llvm::Value *comparisonCode = m_generator->m_builder.CreateFCmpONE(
-      *conditionCode,
-      llvm::ConstantFP::get(m_generator->m_context, llvm::APFloat(0.0)));
-
-  // create blocks
-  llvm::Function *functionCode =
-      m_generator->m_builder.GetInsertBlock()->getParent();
-  llvm::BasicBlock *blockBB =
-      llvm::BasicBlock::Create(m_generator->m_context, "", functionCode);
-  llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(m_generator->m_context);
-
-  // create the conditional branch
-  m_generator->m_builder.CreateCondBr(comparisonCode, blockBB, afterBB);
-
-  m_generator->m_builder.SetInsertPoint(blockBB);
-
-  bool terminated = false;
-  for (auto &line : m_block) {
-    GenStatus lineResult = line->codegen();
-    if (lineResult != GenStatus::ok) {
-      return lineResult;
-    }
-  }
-
-  // updation
-  GenStatus updationResult = m_updation->codegen();
-  if (updationResult == GenStatus::error) {
-    return GenStatus::error;
-  }
-
-  if (!m_updation->terminatesBlock()) {
-    m_generator->m_builder.CreateCondBr(comparisonCode, blockBB, afterBB);
-  }
-
-  // Todo: just terminate processing if the block is terminated
-  m_generator->m_builder.SetInsertPoint(afterBB);
-
-  return GenStatus::ok;
+expressionRef SyntaxTree::addVariable(Symbol t_name) {
+  Node node(NodeKind::variable);
+  node.m_name = t_name;
+  return add(node);
 }
 
-GenStatus DeclarationAST::codegen() {
-  if (m_generator->m_namedValues.find(m_name) !=
-      m_generator->m_namedValues.end()) {
-    llvm::errs() << "Variable '" << m_name
-                 << "' already exists in this scope.\n";
-    return GenStatus::error;
-  }
-  llvm::AllocaInst *inst = m_generator->m_builder.CreateAlloca(
-      llvm::Type::getDoubleTy(m_generator->m_context));
-  m_generator->m_namedValues[m_name] = inst;
-
-  // let a = blah;
-  if (m_value) {
-    auto valueRes = (*m_value)->codegenE();
-    if (!valueRes) {
-      return GenStatus::error;
-    }
-
-    m_generator->m_builder.CreateStore(*valueRes, inst);
-  }
-
-  return GenStatus::ok;
+expressionRef SyntaxTree::addIndex(expressionRef t_array,
+                                   expressionRef t_index) {
+  Node node(NodeKind::index);
+  node.m_operands = {t_array, t_index};
+  return add(node);
 }
 
-std::optional<llvm::Function *> PrototypeAST::codegen() {
-  // all doubles for now
-  std::vector<llvm::Type *> tmpType(
-      m_args.size(), llvm::Type::getDoubleTy(m_generator->m_context));
+expressionRef SyntaxTree::addBinaryOp(OpCode t_op, expressionRef t_lhs,
+                                      expressionRef t_rhs) {
+  Node node(NodeKind::binaryOp);
+  node.m_op = t_op;
+  node.m_operands = {t_lhs, t_rhs};
+  return add(node);
+}
 
-  llvm::FunctionType *funcType = llvm::FunctionType::get(
-      llvm::Type::getDoubleTy(m_generator->m_context), tmpType, false);
+expressionRef SyntaxTree::addAssignmentOp(OpCode t_op, Symbol t_name,
+                                          expressionRef t_value) {
+  Node node(NodeKind::assignmentOp);
+  node.m_op = t_op;
+  node.m_name = t_name;
+  node.m_operands = {t_value};
+  return add(node);
+}
 
-  // add the function to the functions table
-  llvm::Function *funcCode = llvm::Function::Create(
-      funcType, llvm::Function::InternalLinkage, m_name, m_generator->m_module);
+expressionRef SyntaxTree::addIndexAssignmentOp(OpCode t_op,
+                                               expressionRef t_array,
+                                               expressionRef t_index,
+                                               expressionRef t_value) {
+  Node node(NodeKind::indexAssignmentOp);
+  node.m_op = t_op;
+  node.m_operands = {t_array, t_index, t_value};
+  return add(node);
+}
 
-  // add the argument to the variables table
-  size_t it = 0;
-  for (auto &arg : funcCode->args()) {
-    arg.setName(m_args[it++]);
-  }
+expressionRef SyntaxTree::addCall(Symbol t_callee, NodeList<Node> t_args) {
+  Node node(NodeKind::call);
+  node.m_name = t_callee;
+  node.m_list = t_args;
+  return add(node);
+}
 
-  return funcCode;
+lineRef SyntaxTree::addConditional(NodeList<Node> t_conditions,
+                                   ArenaList<blockRef> t_blocks) {
+  Node node(NodeKind::conditional);
+  node.m_list = t_conditions;
+  node.m_blocks = t_blocks;
+  return add(node);
 }
 
-GenStatus ReturnAST::codegen() {
-  if (auto exprCode = m_expression->codegenE()) {
-    m_generator->m_builder.CreateRet(*exprCode);
-    return GenStatus::terminated;
-  }
-  return GenStatus::error;
+lineRef SyntaxTree::addWhile(expressionRef t_condition, blockRef t_body,
+                             ArenaList<Attribute> t_attributes) {
+  Node node(NodeKind::whileLoop);
+  node.m_operands = {t_condition};
+  node.m_list = t_body;
+  node.m_attributes = t_attributes;
+  return add(node);
 }
 
-std::optional<llvm::Function *> FunctionAST::codegen() {
-  // check for existing function
-  std::optional<llvm::Function *> funcCode =
-      m_generator->m_module.getFunction(m_prototype->getName());
+lineRef SyntaxTree::addFor(lineRef t_initialization, expressionRef t_condition,
+                           lineRef t_updation, blockRef t_body,
+                           ArenaList<Attribute> t_attributes) {
+  Node node(NodeKind::forLoop);
+  node.m_operands = {t_initialization, t_condition, t_updation};
+  node.m_list = t_body;
+  node.m_attributes = t_attributes;
+  return add(node);
+}
 
-  // create if it doesn't exist
-  if (!*funcCode) {
-    funcCode = m_prototype->codegen();
-  }
+lineRef SyntaxTree::addDeclaration(Symbol t_name, expressionRef t_value,
+                                   ValueType t_type, uint32_t t_length,
+                                   ArenaList<Attribute> t_attributes) {
+  Node node(NodeKind::declaration);
+  node.m_name = t_name;
+  node.m_type = t_type;
+  node.m_number = t_length;
+  node.m_operands = {t_value};
+  node.m_attributes = t_attributes;
+  return add(node);
+}
 
-  if (!funcCode) {
-    return {};
-  }
-  if (!(*funcCode)->empty()) {
-    std::cerr << "Cannot redefine function.\n";
-    return {};
-  }
+lineRef SyntaxTree::addReturn(expressionRef t_value) {
+  Node node(NodeKind::returnLine);
+  node.m_operands = {t_value};
+  return add(node);
+}
 
-  // parse the body
-  llvm::BasicBlock *definitionBlock = llvm::BasicBlock::Create(
-      m_generator->m_context, "",
-      *funcCode); // creates the "block" to be jumped to
+nodeRef SyntaxTree::addPrototype(Symbol t_name, ArenaList<Parameter> t_params,
+                                 ValueType t_returnType,
+                                 ArenaList<Attribute> t_attributes) {
+  Node node(NodeKind::prototype);
+  node.m_name = t_name;
+  node.m_params = t_params;
+  node.m_type = t_returnType;
+  node.m_attributes = t_attributes;
+  return add(node);
+}
 
-  // set code insertion point
-  m_generator->m_builder.SetInsertPoint(definitionBlock);
+nodeRef SyntaxTree::addFunction(nodeRef t_prototype, blockRef t_body) {
+  Node node(NodeKind::function);
+  node.m_operands = {t_prototype};
+  node.m_list = t_body;
+  return add(node);
+}
 
-  // make the only named values the ones defined in the prototype
-  m_generator->m_namedValues.clear();
-  for (auto &arg : (*funcCode)->args()) {
-    llvm::AllocaInst *argInst = m_generator->m_builder.CreateAlloca(
-        llvm::Type::getDoubleTy(m_generator->m_context));
-    m_generator->m_builder.CreateStore(&arg, argInst);
-    m_generator->m_namedValues[static_cast<std::string>(arg.getName())] =
-        argInst;
-  }
+uint32_t SyntaxTree::addArrayData(ArrayData t_data) {
+  m_arrays.push_back(std::move(t_data));
+  return m_arrays.size() - 1;
+}
 
-  // parse body
-  for (auto &line : m_body) {
-    GenStatus lineResult = line->codegen();
-    if (lineResult == GenStatus::error) {
-      (*funcCode)->eraseFromParent();
-      return {};
-    } else if (lineResult == GenStatus::terminated) {
-      break;
+bool SyntaxTree::hasAttribute(ArenaList<Attribute> t_attributes,
+                              AttributeKind t_kind) const {
+  for (const Attribute &attribute : items(t_attributes)) {
+    if (attribute.m_kind == t_kind) {
+      return true;
     }
   }
+  return false;
+}
 
-  // verify the generated code
-  if (llvm::verifyFunction(**funcCode, &llvm::errs())) {
-    return {};
+LoopBody SyntaxTree::getLoopBody(nodeRef t_loop) const {
+  const Node &loop = get(t_loop);
+  // the body is parsed after the updation, so it's the rest of the range
+  LoopBody body = {loop.m_operands[2].getId() + 1,
+                   t_loop.getId(),
+                   {get(loop.m_operands[0]).m_name}};
+  for (uint32_t id = body.m_first; id < body.m_end; ++id) {
+    if (m_nodes[id].m_kind == NodeKind::declaration) {
+      body.m_locals.insert(m_nodes[id].m_name);
+    }
   }
-
-  (*funcCode)->setCallingConv(llvm::CallingConv::C);
-
-  // run optimizations
-  m_generator->m_funcPass.run(**funcCode, m_generator->m_funcAnalyzer);
-
-  return funcCode;
-}
\ No newline at end of file
+  return body;
+}
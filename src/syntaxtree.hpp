@@ -1,234 +1,266 @@
 #ifndef BEAVER_SYNTAXTREE_HPP
 #define BEAVER_SYNTAXTREE_HPP
 
-#include "generator.hpp"
-#include "operations.hpp"
-#include "llvm/ADT/APFloat.h"
-#include "llvm/ADT/STLExtras.h"
-#include "llvm/IR/BasicBlock.h"
-#include "llvm/IR/Constants.h"
-#include "llvm/IR/DerivedTypes.h"
-#include "llvm/IR/Function.h"
-#include "llvm/Support/TargetSelect.h"
-#include "llvm/Target/TargetMachine.h"
-#include "llvm/Transforms/Utils/BasicBlockUtils.h"
-#include <iostream>
-#include <map>
-#include <memory>
-#include <optional>
-#include <string>
+#include "arena.hpp"
+#include "symboltable.hpp"
+#include "tokens.hpp"
+#include "types.hpp"
+#include <array>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
-// Options for result of code generation
-enum class GenStatus { ok, terminated, error };
-
-// base AST class
-class SyntaxTree {
-protected:
-  std::shared_ptr<Generator> m_generator;
-
-public:
-  SyntaxTree(std::shared_ptr<Generator> t_generator)
-      : m_generator(t_generator) {}
-  virtual ~SyntaxTree() = default;
-  virtual GenStatus codegen() = 0;
-  virtual bool terminatesBlock() { return false; }
-};
-
-class ExpressionTree : public SyntaxTree {
-public:
-  ExpressionTree(std::shared_ptr<Generator> t_generator)
-      : SyntaxTree(t_generator) {}
-  virtual ~ExpressionTree() = default;
-  virtual std::optional<llvm::Value *> codegenE() = 0;
-  // temporary
-  inline GenStatus codegen() override final {
-    if (codegenE()) {
-      return GenStatus::ok;
-    }
-    return GenStatus::error;
-  }
-};
-
-using linePtr = std::unique_ptr<SyntaxTree>;
-using expressionPtr = std::unique_ptr<ExpressionTree>;
-using blockPtr = std::vector<std::unique_ptr<SyntaxTree>>;
-
-class NumberAST : public ExpressionTree {
-private:
-  double m_value;
-
-public:
-  NumberAST(std::shared_ptr<Generator> t_generator, const double t_value)
-      : ExpressionTree(t_generator), m_value(t_value) {}
-  std::optional<llvm::Value *> codegenE() override;
+enum class NodeKind : uint8_t {
+  // expressions
+  number,
+  arrayData,
+  variable,
+  index,
+  binaryOp,
+  assignmentOp,
+  indexAssignmentOp,
+  call,
+  // lines
+  conditional,
+  whileLoop,
+  forLoop,
+  declaration,
+  returnLine,
+  // top level
+  prototype,
+  function,
+  // left behind when a pass replaces a subtree with a single node, and
+  // skipped by everything after it
+  removed
 };
 
-class VariableAST : public ExpressionTree {
-private:
-  std::string m_name;
-
-public:
-  VariableAST(std::shared_ptr<Generator> t_generator, const std::string &t_name)
-      : ExpressionTree(t_generator), m_name(t_name) {}
-  std::optional<llvm::Value *> codegenE() override;
+inline bool isExpression(NodeKind t_kind) { return t_kind <= NodeKind::call; }
+
+// Attributes written before a line, like "@unroll(4)"
+enum class AttributeKind : uint8_t {
+  // loops
+  unroll,
+  noUnroll,
+  vectorize,
+  noVectorize,
+  // functions
+  alwaysInline,
+  noInline,
+  cold,
+  hot,
+  tailRec,
+  // found by the effect analysis, and can't be written
+  readNone,
+  noUnwind,
+  willReturn,
+  // on return lines whose value is a call that can be a tail call, found by
+  // the type checker
+  tailCall,
+  // the const keyword, on functions and declarations
+  constant,
+  // the pfor keyword, on for loops whose iterations run in parallel
+  parallel
 };
 
-// binary operations
-class BinaryOpAST : public ExpressionTree {
-private:
-  const Operation m_op;
-  expressionPtr m_lhs, m_rhs;
-
-public:
-  BinaryOpAST(std::shared_ptr<Generator> t_generator, const Operation t_op,
-              expressionPtr t_lhs, expressionPtr t_rhs)
-      : ExpressionTree(t_generator), m_op(t_op), m_lhs(std::move(t_lhs)),
-        m_rhs(std::move(t_rhs)) {}
-  std::optional<llvm::Value *> codegenE() override;
+// m_value is the number in parentheses, or 0 if there isn't one
+struct Attribute {
+  AttributeKind m_kind;
+  uint32_t m_value;
 };
 
-// assignment operations
-class AssignmentOpAST : public ExpressionTree {
-private:
-  const Operation m_op;
-  std::string m_lhs;
-  expressionPtr m_rhs;
-
-public:
-  AssignmentOpAST(std::shared_ptr<Generator> t_generator, const Operation t_op,
-                  std::string t_lhs, expressionPtr t_rhs)
-      : ExpressionTree(t_generator), m_op(t_op), m_lhs(std::move(t_lhs)),
-        m_rhs(std::move(t_rhs)) {}
-  std::optional<llvm::Value *> codegenE() override;
+// parameter of a function
+struct Parameter {
+  Symbol m_name;
+  ValueType m_type;
 };
 
-// function calls
-class CallAST : public ExpressionTree {
-private:
-  std::string m_callee;
-  std::vector<expressionPtr> m_args;
-
-public:
-  CallAST(std::shared_ptr<Generator> t_generator, const std::string &t_callee,
-          std::vector<expressionPtr> t_args)
-      : ExpressionTree(t_generator), m_callee(t_callee),
-        m_args(std::move(t_args)) {}
-  std::optional<llvm::Value *> codegenE() override;
+// Elements of an array that is known while compiling
+// integer arrays use m_integers and f64 arrays use m_numbers
+struct ArrayData {
+  std::vector<int64_t> m_integers;
+  std::vector<double> m_numbers;
 };
 
-// if/else
-class ConditionalAST : public SyntaxTree {
-private:
-  std::vector<expressionPtr> m_conditions;
-  std::vector<blockPtr> m_mainBlocks;
-  std::optional<blockPtr> m_elseBlock;
-
-public:
-  ConditionalAST(std::shared_ptr<Generator> t_generator,
-                 std::vector<expressionPtr> t_conditions,
-                 std::vector<blockPtr> t_mainBlocks,
-                 std::optional<blockPtr> t_elseBlock)
-      : SyntaxTree(t_generator), m_conditions(std::move(t_conditions)),
-        m_mainBlocks(std::move(t_mainBlocks)),
-        m_elseBlock(std::move(t_elseBlock)) {}
-  ~ConditionalAST() = default;
-
-  GenStatus codegen() override;
+// The body of a for loop, as the range of nodes [m_first, m_end)
+// m_locals are the variables it declares, and the index, so every other
+// variable it uses comes from outside the loop
+struct LoopBody {
+  uint32_t m_first;
+  uint32_t m_end;
+  std::unordered_set<Symbol> m_locals;
 };
 
-class WhileAST : public SyntaxTree {
-private:
-  expressionPtr m_condition;
-  blockPtr m_block;
-
-public:
-  WhileAST(std::shared_ptr<Generator> t_generator, expressionPtr t_condition,
-           blockPtr t_block)
-      : SyntaxTree(t_generator), m_condition(std::move(t_condition)),
-        m_block(std::move(t_block)) {}
-  ~WhileAST() = default;
-
-  GenStatus codegen() override;
+struct Node;
+
+using nodeRef = NodeRef<Node>;
+using lineRef = nodeRef;
+using expressionRef = nodeRef;
+using blockRef = NodeList<Node>;
+
+// One node of the syntax tree
+// Every kind of node has the same layout, and the kind decides which fields
+// are used:
+//   number        m_number, and m_integer once it has an integer or bool
+//                 type
+//   arrayData     m_type, m_integer is the index of the elements in the
+//                 tree's array data
+//   variable      m_name
+//   index         m_operands = {array, index}
+//   binaryOp      m_op, m_operands = {lhs, rhs}, m_type is the type both
+//                 operands are converted to
+//   assignmentOp  m_op, m_name, m_operands = {value}
+//   indexAssignmentOp
+//                 m_op, m_operands = {array, index, value}
+//   call          m_name, m_list = arguments
+//   conditional   m_list = conditions, m_blocks = a block for each condition,
+//                 followed by the else block if there is one
+//   whileLoop     m_operands = {condition}, m_list = body, m_attributes
+//   forLoop       m_operands = {initialization, condition, updation},
+//                 m_list = body, m_attributes
+//   declaration   m_name, m_operands = {value}, which may be empty, m_type,
+//                 m_number is the length of a fixed-size array, or 0,
+//                 m_attributes
+//   returnLine    m_operands = {value}, m_attributes
+//   prototype     m_name, m_params, m_type is the return type, m_attributes
+//   function      m_operands = {prototype}, m_list = body
+// The type checker fills in m_type of every expression, and of declarations
+// without an annotation
+struct Node {
+  NodeKind m_kind;
+  OpCode m_op = OpCode::none;
+  ValueType m_type = ValueType::unknown;
+  // first node of the subtree rooted at this node
+  uint32_t m_first = 0;
+  Symbol m_name = 0;
+  std::array<nodeRef, 3> m_operands;
+  NodeList<Node> m_list;
+  ArenaList<blockRef> m_blocks;
+  ArenaList<Parameter> m_params;
+  ArenaList<Attribute> m_attributes;
+  double m_number = 0;
+  int64_t m_integer = 0;
+
+  Node(NodeKind t_kind) : m_kind(t_kind) {}
 };
 
-class ForAST : public SyntaxTree {
+// Owns the nodes of a compilation unit
+// Nodes are stored contiguously and children are always added before their
+// parents, so the nodes are in post-order and the subtree of a node is the
+// range [m_first, node]
+// Passes switch on the kind of each node, either by walking the children or
+// by scanning a range of nodes in order
+class SyntaxTree {
 private:
-  linePtr m_initialization;
-  expressionPtr m_condition;
-  linePtr m_updation;
-  blockPtr m_block;
+  std::vector<Node> m_nodes;
+  SyntaxArena m_lists;
+  // top-level prototypes and functions, in source order
+  std::vector<nodeRef> m_items;
+  std::vector<ArrayData> m_arrays;
+  // names of the compiled modules the file imports
+  std::vector<Symbol> m_imports;
 
-public:
-  ForAST(std::shared_ptr<Generator> t_generator, linePtr t_initialization,
-         expressionPtr t_condition, linePtr t_updation, blockPtr t_block)
-      : SyntaxTree(t_generator), m_initialization(std::move(t_initialization)),
-        m_condition(std::move(t_condition)), m_updation(std::move(t_updation)),
-        m_block(std::move(t_block)) {}
-  ~ForAST() = default;
-
-  GenStatus codegen() override;
-};
-
-class DeclarationAST : public SyntaxTree {
-private:
-  std::string m_name;
-  std::optional<expressionPtr> m_value;
+  nodeRef add(Node t_node);
 
 public:
-  DeclarationAST(std::shared_ptr<Generator> t_generator, std::string &t_name,
-                 std::optional<expressionPtr> t_value)
-      : SyntaxTree(t_generator), m_name(t_name), m_value(std::move(t_value)) {}
-  ~DeclarationAST() = default;
-
-  GenStatus codegen() override;
-};
-
-class PrototypeAST {
-private:
-  std::shared_ptr<Generator> m_generator;
-  std::string m_name;
-  std::vector<std::string> m_args;
+  // node 0 is a placeholder so that a default handle refers to nothing
+  SyntaxTree() : m_nodes(1, Node(NodeKind::number)) {}
+  SyntaxTree(const SyntaxTree &) = delete;
+  SyntaxTree &operator=(const SyntaxTree &) = delete;
+  SyntaxTree(SyntaxTree &&) = default;
+  SyntaxTree &operator=(SyntaxTree &&) = default;
+
+  // build nodes
+  // t_type is set for literals that always have the same type, like true
+  expressionRef addNumber(double t_value,
+                          ValueType t_type = ValueType::unknown);
+  expressionRef addVariable(Symbol t_name);
+  expressionRef addIndex(expressionRef t_array, expressionRef t_index);
+  expressionRef addBinaryOp(OpCode t_op, expressionRef t_lhs,
+                            expressionRef t_rhs);
+  expressionRef addAssignmentOp(OpCode t_op, Symbol t_name,
+                                expressionRef t_value);
+  expressionRef addIndexAssignmentOp(OpCode t_op, expressionRef t_array,
+                                     expressionRef t_index,
+                                     expressionRef t_value);
+  expressionRef addCall(Symbol t_callee, NodeList<Node> t_args);
+  lineRef addConditional(NodeList<Node> t_conditions,
+                         ArenaList<blockRef> t_blocks);
+  lineRef addWhile(expressionRef t_condition, blockRef t_body,
+                   ArenaList<Attribute> t_attributes);
+  lineRef addFor(lineRef t_initialization, expressionRef t_condition,
+                 lineRef t_updation, blockRef t_body,
+                 ArenaList<Attribute> t_attributes);
+  // t_length is only set for fixed-size arrays
+  lineRef addDeclaration(Symbol t_name, expressionRef t_value, ValueType t_type,
+                         uint32_t t_length = 0,
+                         ArenaList<Attribute> t_attributes = {});
+  lineRef addReturn(expressionRef t_value);
+  nodeRef addPrototype(Symbol t_name, ArenaList<Parameter> t_params,
+                       ValueType t_returnType,
+                       ArenaList<Attribute> t_attributes = {});
+  nodeRef addFunction(nodeRef t_prototype, blockRef t_body);
+
+  // elements of arrayData nodes
+  uint32_t addArrayData(ArrayData t_data);
+  const ArrayData &getArrayData(uint32_t t_index) const {
+    return m_arrays[t_index];
+  }
 
-public:
-  PrototypeAST(std::shared_ptr<Generator> t_generator,
-               const std::string &t_name, std::vector<std::string> t_args)
-      : m_generator(t_generator), m_name(t_name), m_args(std::move(t_args)) {}
-  ~PrototypeAST() = default;
-  const std::string &getName() const { return m_name; }
+  // top-level items are lowered in the order they are added
+  void addItem(nodeRef t_item) { m_items.push_back(t_item); }
+  const std::vector<nodeRef> &getItems() const { return m_items; }
 
-  std::optional<llvm::Function *> codegen();
-};
+  void addImport(Symbol t_module) { m_imports.push_back(t_module); }
+  const std::vector<Symbol> &getImports() const { return m_imports; }
 
-// return values
-class ReturnAST : public SyntaxTree {
-private:
-  expressionPtr m_expression;
+  template <typename T> ArenaList<T> makeList(const std::vector<T> &t_items) {
+    return m_lists.makeList(t_items);
+  }
+  template <typename T> ArenaRange<T> items(ArenaList<T> t_list) const {
+    return m_lists.items(t_list);
+  }
+  template <typename T>
+  const T &at(ArenaList<T> t_list, uint32_t t_index) const {
+    return m_lists.at(t_list, t_index);
+  }
+  bool hasAttribute(ArenaList<Attribute> t_attributes,
+                    AttributeKind t_kind) const;
+  LoopBody getLoopBody(nodeRef t_loop) const;
 
-public:
-  ReturnAST(std::shared_ptr<Generator> t_generator, expressionPtr t_expression)
-      : SyntaxTree(t_generator), m_expression(std::move(t_expression)) {}
-  ~ReturnAST() = default;
+  const Node &get(nodeRef t_ref) const { return m_nodes[t_ref.getId()]; }
+  Node &get(nodeRef t_ref) { return m_nodes[t_ref.getId()]; }
+  uint32_t size() const { return m_nodes.size(); }
 
-  GenStatus codegen() override;
-  virtual bool terminatesBlock() override { return true; }
+  // call t_func on every direct child of a node, in source order
+  template <typename F> void forEachChild(nodeRef t_ref, F &&t_func) const;
 };
 
-// function definitions
-class FunctionAST {
-private:
-  std::shared_ptr<Generator> m_generator;
-  std::unique_ptr<PrototypeAST> m_prototype;
-  blockPtr m_body;
-
-public:
-  FunctionAST(std::shared_ptr<Generator> t_generator,
-              std::unique_ptr<PrototypeAST> t_prototype, blockPtr t_body)
-      : m_generator(t_generator), m_prototype(std::move(t_prototype)),
-        m_body(std::move(t_body)) {}
-  ~FunctionAST() = default;
-
-  std::optional<llvm::Function *> codegen();
-};
+template <typename F>
+void SyntaxTree::forEachChild(nodeRef t_ref, F &&t_func) const {
+  const Node &node = get(t_ref);
+  switch (node.m_kind) {
+  case NodeKind::conditional:
+    for (uint32_t i = 0; i < node.m_blocks.size(); ++i) {
+      if (i < node.m_list.size()) {
+        t_func(at(node.m_list, i));
+      }
+      for (nodeRef line : items(at(node.m_blocks, i))) {
+        t_func(line);
+      }
+    }
+    return;
+  default:
+    for (nodeRef operand : node.m_operands) {
+      if (operand.isValid()) {
+        t_func(operand);
+      }
+    }
+    for (nodeRef child : items(node.m_list)) {
+      t_func(child);
+    }
+    return;
+  }
+}
 
-#endif // BEAVER_SYNTAXTREE_HPP
\ No newline at end of file
+#endif // BEAVER_SYNTAXTREE_HPP
@@ -0,0 +1,18 @@
+#include "tokens.hpp"
+
+void TokenBuffer::reserve(size_t t_count) {
+  m_kinds.reserve(t_count);
+  m_values.reserve(t_count);
+  m_spans.reserve(t_count);
+}
+
+void TokenBuffer::push(Token t_kind, uint32_t t_value, SourceSpan t_span) {
+  m_kinds.push_back(t_kind);
+  m_values.push_back(t_value);
+  m_spans.push_back(t_span);
+}
+
+void TokenBuffer::pushNumber(double t_value, SourceSpan t_span) {
+  push(Token::number, m_numbers.size(), t_span);
+  m_numbers.push_back(t_value);
+}
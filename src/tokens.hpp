@@ -0,0 +1,159 @@
+#ifndef BEAVER_TOKENS_HPP
+#define BEAVER_TOKENS_HPP
+
+#include "symboltable.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+// Class for all special tokens
+enum class Token : uint8_t {
+  unknown,
+  endFile,
+  func,
+  externTok,
+  importTok,
+  identifier,
+  number,
+  ifTok,
+  elifTok,
+  elseTok,
+  returnTok,
+  whileTok,
+  forTok,
+  pforTok,
+  letTok,
+  constTok,
+  trueTok,
+  falseTok,
+  operation
+};
+
+// Operators, classified by the lexer so the parser doesn't have to look at
+// the text again
+enum class OpCode : uint8_t {
+  none,
+  // binary operators
+  add,
+  sub,
+  mult,
+  div,
+  mod,
+  lesser,
+  greater,
+  lesserEq,
+  greaterEq,
+  equalTo,
+  notEqTo,
+  // assignment operators
+  assign,
+  plusEq,
+  minusEq,
+  timesEq,
+  divEq,
+  modEq,
+  // type annotations
+  colon,
+  arrow
+};
+
+// location of a token in its source buffer
+struct SourceSpan {
+  uint32_t offset;
+  uint32_t length;
+};
+
+// A fully lexed file, stored as a struct of arrays
+// Each token has a kind, a span and one 32 bit value whose meaning depends on
+// the kind:
+//  - identifier: the interned Symbol
+//  - number: index into the literal table
+//  - operation: the OpCode
+//  - unknown: the character
+class TokenBuffer {
+private:
+  std::vector<Token> m_kinds;
+  std::vector<uint32_t> m_values;
+  std::vector<SourceSpan> m_spans;
+  std::vector<double> m_numbers;
+
+public:
+  TokenBuffer() = default;
+  ~TokenBuffer() = default;
+
+  void reserve(size_t t_count);
+  void push(Token t_kind, uint32_t t_value, SourceSpan t_span);
+  void pushNumber(double t_value, SourceSpan t_span);
+
+  inline size_t size() const { return m_kinds.size(); }
+  inline Token getKind(size_t t_index) const { return m_kinds[t_index]; }
+  inline uint32_t getValue(size_t t_index) const { return m_values[t_index]; }
+  inline SourceSpan getSpan(size_t t_index) const { return m_spans[t_index]; }
+  inline double getNumber(size_t t_index) const {
+    return m_numbers[m_values[t_index]];
+  }
+};
+
+// Cursor over a TokenBuffer, used by the parser
+// Since the whole file is already lexed, looking ahead is just an index
+class TokenStream {
+private:
+  TokenBuffer m_buffer;
+  size_t m_index;
+
+  // the last token is always Token::endFile, so never move past it
+  inline size_t clamp(size_t t_index) const {
+    return t_index < m_buffer.size() ? t_index : m_buffer.size() - 1;
+  }
+
+public:
+  TokenStream(TokenBuffer t_buffer)
+      : m_buffer(std::move(t_buffer)), m_index(0) {}
+  ~TokenStream() = default;
+
+  // Functions to get information about the current token
+
+  inline Token getTok() const { return m_buffer.getKind(m_index); }
+  inline SourceSpan getSpan() const { return m_buffer.getSpan(m_index); }
+  inline Symbol getSymbol() const { return m_buffer.getValue(m_index); }
+  inline std::string_view getIdentifier() const {
+    return symbols().getName(getSymbol());
+  }
+  inline double getNum() const { return m_buffer.getNumber(m_index); }
+
+  // the operator, or OpCode::none if the token isn't an operation
+  inline OpCode getOpCode() const {
+    if (getTok() != Token::operation) {
+      return OpCode::none;
+    }
+    return static_cast<OpCode>(m_buffer.getValue(m_index));
+  }
+
+  // the character of a single character token, EOF at the end of the file,
+  // and 0 otherwise
+  inline char getChar() const {
+    switch (getTok()) {
+    case Token::unknown:
+      return static_cast<char>(m_buffer.getValue(m_index));
+    case Token::endFile:
+      return EOF;
+    default:
+      return 0;
+    }
+  }
+
+  // kind of the token t_ahead tokens after the current one
+  inline Token peekTok(size_t t_ahead) const {
+    return m_buffer.getKind(clamp(m_index + t_ahead));
+  }
+
+  // move to the next token
+  inline Token nextToken() {
+    m_index = clamp(m_index + 1);
+    return getTok();
+  }
+};
+
+#endif // BEAVER_TOKENS_HPP
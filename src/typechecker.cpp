@@ -0,0 +1,789 @@
+#include "typechecker.hpp"
+#include "lexer.hpp"
+#include <cmath>
+
+// the text of an operator, for errors
+static std::string_view getOpName(OpCode t_op) {
+  for (auto &[name, op] : lexer::OpKeyList) {
+    if (op == t_op) {
+      return name;
+    }
+  }
+  return "?";
+}
+
+static bool isArithmetic(OpCode t_op) {
+  return t_op >= OpCode::add && t_op <= OpCode::mod;
+}
+
+// a number literal, whose type comes from its context
+static bool isLiteral(const Node &t_node) {
+  return t_node.m_kind == NodeKind::number &&
+         t_node.m_type != ValueType::boolean;
+}
+
+TypeChecker::TypeChecker(SyntaxTree &t_tree) : m_tree(t_tree) {
+  for (nodeRef item : m_tree.getItems()) {
+    const Node &node = m_tree.get(item);
+    nodeRef prototype =
+        node.m_kind == NodeKind::function ? node.m_operands[0] : item;
+    m_signatures.emplace(m_tree.get(prototype).m_name, prototype);
+  }
+}
+
+std::optional<ValueType>
+TypeChecker::checkExpression(expressionRef t_expression, ValueType t_expected) {
+  Node &node = m_tree.get(t_expression);
+  switch (node.m_kind) {
+  case NodeKind::number: {
+    if (node.m_type == ValueType::boolean) {
+      return node.m_type;
+    }
+    // literals are f64 unless the context wants an integer, and in a vector
+    // context they have the type of its lanes
+    ValueType wanted =
+        isVector(t_expected) ? getLaneType(t_expected) : t_expected;
+    node.m_type = isNumeric(wanted) ? wanted : ValueType::f64;
+    double limit =
+        node.m_type == ValueType::i32 ? 2147483648.0 : 9223372036854775808.0;
+    if (isInteger(node.m_type) && (node.m_number != std::floor(node.m_number) ||
+                                   node.m_number >= limit)) {
+      llvm::errs() << "Expected a whole number that fits in "
+                   << getTypeName(node.m_type) << ".\n";
+      return {};
+    }
+    if (isInteger(node.m_type)) {
+      node.m_integer = static_cast<int64_t>(node.m_number);
+    }
+    return node.m_type;
+  }
+  case NodeKind::variable: {
+    auto variable = m_variables.find(node.m_name);
+    if (variable == m_variables.end()) {
+      llvm::errs() << "Unknown variable name: "
+                   << symbols().getName(node.m_name) << '\n';
+      return {};
+    }
+    node.m_type = variable->second;
+    return node.m_type;
+  }
+  case NodeKind::index:
+    return checkIndex(node, false);
+  case NodeKind::binaryOp:
+    return checkBinaryOp(node, t_expected);
+  case NodeKind::assignmentOp: {
+    auto variable = m_variables.find(node.m_name);
+    if (variable == m_variables.end()) {
+      llvm::errs() << "Unknown variable name: "
+                   << symbols().getName(node.m_name) << '\n';
+      return {};
+    }
+    node.m_type = variable->second;
+    if (m_constants.count(node.m_name)) {
+      llvm::errs() << "Can't assign to the constant '"
+                   << symbols().getName(node.m_name) << "'.\n";
+      return {};
+    }
+    if (node.m_op != OpCode::assign && !isNumeric(node.m_type) &&
+        !isNumericVector(node.m_type)) {
+      llvm::errs() << "Operator '" << getOpName(node.m_op)
+                   << "' can't be used on " << getTypeName(node.m_type)
+                   << ".\n";
+      return {};
+    }
+    if (!checkValue(node.m_operands[0], node.m_type)) {
+      return {};
+    }
+    return node.m_type;
+  }
+  case NodeKind::indexAssignmentOp: {
+    // elements are always numbers, so every assignment operator works
+    if (!checkIndex(node, true) || !checkChangeable(node.m_operands[0]) ||
+        !checkValue(node.m_operands[2], node.m_type)) {
+      return {};
+    }
+    return node.m_type;
+  }
+  case NodeKind::call:
+    return checkCall(node, t_expected);
+  default:
+    llvm::errs() << "Unexpected statement in expression.\n";
+    return {};
+  }
+}
+
+std::optional<ValueType> TypeChecker::unify(std::string_view t_name,
+                                            ValueType t_first,
+                                            ValueType t_second) {
+  // booleans are converted to the type of the other operand, and values to
+  // vectors of their type
+  if (isConvertible(t_first, t_second)) {
+    return t_second;
+  }
+  if (isConvertible(t_second, t_first)) {
+    return t_first;
+  }
+  llvm::errs() << "Mismatched types for '" << t_name
+               << "': " << getTypeName(t_first) << " and "
+               << getTypeName(t_second) << ".\n";
+  return {};
+}
+
+std::optional<ValueType> TypeChecker::checkOperands(std::string_view t_name,
+                                                    expressionRef t_first,
+                                                    expressionRef t_second,
+                                                    ValueType t_expected) {
+  // a literal gets the type of the other operand, so that one goes first
+  if (isLiteral(m_tree.get(t_first)) && !isLiteral(m_tree.get(t_second))) {
+    std::swap(t_first, t_second);
+  }
+  auto firstType = checkExpression(t_first, t_expected);
+  if (!firstType) {
+    return {};
+  }
+  auto secondType = checkExpression(
+      t_second, *firstType == ValueType::boolean ? t_expected : *firstType);
+  if (!secondType) {
+    return {};
+  }
+  for (ValueType operandType : {*firstType, *secondType}) {
+    if (!isScalar(operandType) && !isVector(operandType)) {
+      llvm::errs() << "'" << t_name << "' can't be used on "
+                   << getTypeName(operandType) << ".\n";
+      return {};
+    }
+  }
+  return unify(t_name, *firstType, *secondType);
+}
+
+std::optional<ValueType> TypeChecker::checkBinaryOp(Node &t_node,
+                                                    ValueType t_expected) {
+  bool arithmetic = isArithmetic(t_node.m_op);
+  ValueType operandExpected =
+      arithmetic && (isNumeric(t_expected) || isNumericVector(t_expected))
+          ? t_expected
+          : ValueType::unknown;
+  std::string_view name = getOpName(t_node.m_op);
+  auto type = checkOperands(name, t_node.m_operands[0], t_node.m_operands[1],
+                            operandExpected);
+  if (!type) {
+    return {};
+  }
+
+  // masks are only used by select
+  if (isVector(*type) && !isNumericVector(*type)) {
+    llvm::errs() << "'" << name << "' can't be used on " << getTypeName(*type)
+                 << ".\n";
+    return {};
+  }
+
+  // only equality works on booleans themselves, anything else uses them as
+  // numbers
+  bool equality =
+      t_node.m_op == OpCode::equalTo || t_node.m_op == OpCode::notEqTo;
+  if (*type == ValueType::boolean && !equality) {
+    type = isNumeric(operandExpected) ? operandExpected : ValueType::f64;
+  }
+  t_node.m_type = *type;
+
+  // comparing vectors gives a mask
+  if (arithmetic) {
+    return type;
+  }
+  if (isVector(*type)) {
+    return getVectorType(ValueType::boolean, getLaneCount(*type));
+  }
+  return ValueType::boolean;
+}
+
+std::optional<ValueType> TypeChecker::checkIndex(Node &t_node,
+                                                 bool t_assigned) {
+  auto type = checkExpression(t_node.m_operands[0], ValueType::unknown);
+  if (!type) {
+    return {};
+  }
+  ValueType element =
+      isArray(*type) ? getElementType(*type) : getLaneType(*type);
+  if (element == ValueType::unknown) {
+    llvm::errs() << "Can't index " << getTypeName(*type) << ".\n";
+    return {};
+  }
+
+  // lanes are written through the variable that holds the vector
+  if (t_assigned && isVector(*type) &&
+      (m_tree.get(t_node.m_operands[0]).m_kind != NodeKind::variable ||
+       !isNumericVector(*type))) {
+    llvm::errs() << "Only lanes of vector variables of numbers can be "
+                    "assigned.\n";
+    return {};
+  }
+
+  if (!checkIndexValue(t_node.m_operands[1])) {
+    return {};
+  }
+  t_node.m_type = element;
+  return t_node.m_type;
+}
+
+bool TypeChecker::checkIndexValue(expressionRef t_index) {
+  auto type = checkExpression(t_index, ValueType::i64);
+  if (!type) {
+    return false;
+  }
+  if (!isInteger(*type)) {
+    llvm::errs() << "Expected an integer index, got " << getTypeName(*type)
+                 << ".\n";
+    return false;
+  }
+  return true;
+}
+
+std::optional<ValueType> TypeChecker::checkArray(expressionRef t_expression) {
+  auto type = checkExpression(t_expression, ValueType::unknown);
+  if (!type) {
+    return {};
+  }
+  if (!isArray(*type)) {
+    llvm::errs() << "Expected an array, got " << getTypeName(*type) << ".\n";
+    return {};
+  }
+  return type;
+}
+
+std::optional<ValueType> TypeChecker::checkBuiltin(Node &t_node,
+                                                   const BuiltinInfo &t_info,
+                                                   ValueType t_expected) {
+  uint32_t numArgs = t_node.m_list.size();
+  if (numArgs < t_info.minArgs || numArgs > t_info.maxArgs) {
+    llvm::errs() << "Incorrect number of arguments for " << t_info.name
+                 << ": expected " << unsigned(t_info.minArgs);
+    if (t_info.maxArgs != t_info.minArgs) {
+      llvm::errs() << " to " << unsigned(t_info.maxArgs);
+    }
+    llvm::errs() << ", got " << numArgs << ".\n";
+    return {};
+  }
+  auto arg = [&](uint32_t t_index) {
+    return m_tree.at(t_node.m_list, t_index);
+  };
+
+  // the context of min, max and fma is passed on to their arguments
+  ValueType operandExpected =
+      isNumeric(t_expected) || isNumericVector(t_expected) ? t_expected
+                                                           : ValueType::unknown;
+
+  switch (t_info.builtin) {
+  case Builtin::alloc:
+    if (!isArray(t_expected)) {
+      llvm::errs() << "The type of alloc has to come from its context, like "
+                      "\"let a: [f64] = alloc(n)\".\n";
+      return {};
+    }
+    if (!checkValue(arg(0), ValueType::i64)) {
+      return {};
+    }
+    t_node.m_type = t_expected;
+    break;
+  case Builtin::free:
+    if (!checkArray(arg(0)) || !checkChangeable(arg(0))) {
+      return {};
+    }
+    t_node.m_type = ValueType::none;
+    break;
+  case Builtin::len: {
+    auto type = checkExpression(arg(0), ValueType::unknown);
+    if (!type) {
+      return {};
+    }
+    if (!isArray(*type) && !isVector(*type)) {
+      llvm::errs() << "Expected an array or a vector, got "
+                   << getTypeName(*type) << ".\n";
+      return {};
+    }
+    t_node.m_type = ValueType::i64;
+    break;
+  }
+  case Builtin::load: {
+    if (!isNumericVector(t_expected)) {
+      llvm::errs() << "The type of load has to come from its context, like "
+                      "\"let v: f64x4 = load(a, i)\".\n";
+      return {};
+    }
+    auto arrayType = checkArray(arg(0));
+    if (!arrayType || !checkIndexValue(arg(1))) {
+      return {};
+    }
+    if (getElementType(*arrayType) != getLaneType(t_expected)) {
+      llvm::errs() << "Can't load " << getTypeName(t_expected) << " from "
+                   << getTypeName(*arrayType) << ".\n";
+      return {};
+    }
+    t_node.m_type = t_expected;
+    break;
+  }
+  case Builtin::store: {
+    auto arrayType = checkArray(arg(0));
+    if (!arrayType || !checkChangeable(arg(0)) || !checkIndexValue(arg(1))) {
+      return {};
+    }
+    auto vectorType = checkExpression(arg(2), ValueType::unknown);
+    if (!vectorType) {
+      return {};
+    }
+    if (getLaneType(*vectorType) != getElementType(*arrayType)) {
+      llvm::errs() << "Can't store " << getTypeName(*vectorType) << " in "
+                   << getTypeName(*arrayType) << ".\n";
+      return {};
+    }
+    t_node.m_type = ValueType::none;
+    break;
+  }
+  case Builtin::shuffle: {
+    auto sourceType = checkExpression(arg(0), ValueType::unknown);
+    if (!sourceType) {
+      return {};
+    }
+    if (!isVector(*sourceType)) {
+      llvm::errs() << "Expected a vector, got " << getTypeName(*sourceType)
+                   << ".\n";
+      return {};
+    }
+
+    // the second source is optional, and the lanes are literals
+    uint32_t sources = 1;
+    if (!isLiteral(m_tree.get(arg(1)))) {
+      if (!checkValue(arg(1), *sourceType)) {
+        return {};
+      }
+      sources = 2;
+    }
+    uint32_t limit = sources * getLaneCount(*sourceType);
+    for (uint32_t i = sources; i < numArgs; ++i) {
+      Node &lane = m_tree.get(arg(i));
+      if (!isLiteral(lane) || lane.m_number < 0 || lane.m_number >= limit ||
+          lane.m_number != std::floor(lane.m_number)) {
+        llvm::errs() << "Expected the lanes of shuffle to be whole numbers "
+                        "from 0 to "
+                     << limit - 1 << ".\n";
+        return {};
+      }
+      lane.m_type = ValueType::i64;
+      lane.m_integer = static_cast<int64_t>(lane.m_number);
+    }
+
+    auto type = getVectorType(getLaneType(*sourceType), numArgs - sources);
+    if (!type) {
+      llvm::errs() << "There's no vector of " << numArgs - sources
+                   << " lanes of " << getTypeName(getLaneType(*sourceType))
+                   << ".\n";
+      return {};
+    }
+    t_node.m_type = *type;
+    break;
+  }
+  case Builtin::reduceAdd:
+  case Builtin::reduceMin:
+  case Builtin::reduceMax: {
+    auto type = checkExpression(arg(0), ValueType::unknown);
+    if (!type) {
+      return {};
+    }
+    if (!isNumericVector(*type)) {
+      llvm::errs() << "Expected a vector of numbers, got " << getTypeName(*type)
+                   << ".\n";
+      return {};
+    }
+    t_node.m_type = getLaneType(*type);
+    break;
+  }
+  case Builtin::min:
+  case Builtin::max:
+  case Builtin::fma: {
+    auto type = checkOperands(t_info.name, arg(0), arg(1), operandExpected);
+    if (!type) {
+      return {};
+    }
+    if (t_info.builtin == Builtin::fma) {
+      auto addend = checkExpression(arg(2), *type);
+      if (!addend) {
+        return {};
+      }
+      type = unify(t_info.name, *type, *addend);
+      if (!type) {
+        return {};
+      }
+    }
+
+    bool valid =
+        t_info.builtin == Builtin::fma
+            ? *type == ValueType::f64 || getLaneType(*type) == ValueType::f64
+            : isNumeric(*type) || isNumericVector(*type);
+    if (!valid) {
+      llvm::errs() << "'" << t_info.name << "' can't be used on "
+                   << getTypeName(*type) << ".\n";
+      return {};
+    }
+    t_node.m_type = *type;
+    break;
+  }
+  case Builtin::select: {
+    auto maskType = checkExpression(arg(0), ValueType::unknown);
+    if (!maskType) {
+      return {};
+    }
+    if (*maskType != ValueType::boolean &&
+        getLaneType(*maskType) != ValueType::boolean) {
+      llvm::errs() << "Expected a bool or a mask, got "
+                   << getTypeName(*maskType) << ".\n";
+      return {};
+    }
+    auto type = checkOperands(t_info.name, arg(1), arg(2), t_expected);
+    if (!type) {
+      return {};
+    }
+
+    // a mask selects each lane, so the values are vectors with as many lanes
+    if (isVector(*maskType)) {
+      uint32_t lanes = getLaneCount(*maskType);
+      std::optional<ValueType> vectorType =
+          isVector(*type) ? *type : getVectorType(*type, lanes);
+      if (!vectorType || getLaneCount(*vectorType) != lanes) {
+        llvm::errs() << "Mismatched types for 'select': "
+                     << getTypeName(*maskType) << " and " << getTypeName(*type)
+                     << ".\n";
+        return {};
+      }
+      type = vectorType;
+    }
+    t_node.m_type = *type;
+    break;
+  }
+  }
+  return t_node.m_type;
+}
+
+std::optional<ValueType> TypeChecker::checkCall(Node &t_node,
+                                                ValueType t_expected) {
+  if (const BuiltinInfo *builtin =
+          getBuiltinInfo(symbols().getName(t_node.m_name))) {
+    return checkBuiltin(t_node, *builtin, t_expected);
+  }
+
+  auto signature = m_signatures.find(t_node.m_name);
+  if (signature == m_signatures.end()) {
+    llvm::errs() << "Unknown function: " << symbols().getName(t_node.m_name)
+                 << '\n';
+    return {};
+  }
+  const Node &prototype = m_tree.get(signature->second);
+  if (m_constFunction &&
+      !m_tree.hasAttribute(prototype.m_attributes, AttributeKind::constant)) {
+    llvm::errs() << "A const fn can only call const fns of its own file, and '"
+                 << symbols().getName(t_node.m_name) << "' isn't one.\n";
+    return {};
+  }
+
+  if (prototype.m_params.size() != t_node.m_list.size()) {
+    llvm::errs() << "Incorrect number of arguments for "
+                 << symbols().getName(t_node.m_name) << ": expected "
+                 << prototype.m_params.size() << ", got "
+                 << t_node.m_list.size() << ".\n";
+    return {};
+  }
+  for (uint32_t i = 0; i < t_node.m_list.size(); ++i) {
+    if (!checkValue(m_tree.at(t_node.m_list, i),
+                    m_tree.at(prototype.m_params, i).m_type)) {
+      return {};
+    }
+  }
+
+  t_node.m_type = prototype.m_type;
+  return t_node.m_type;
+}
+
+bool TypeChecker::checkChangeable(expressionRef t_expression) {
+  const Node &node = m_tree.get(t_expression);
+  if (node.m_kind == NodeKind::variable && m_constants.count(node.m_name)) {
+    llvm::errs() << "The elements of the constant '"
+                 << symbols().getName(node.m_name) << "' can't be changed.\n";
+    return false;
+  }
+  return true;
+}
+
+bool TypeChecker::checkValue(expressionRef t_expression, ValueType t_type) {
+  auto type = checkExpression(t_expression, t_type);
+  if (!type) {
+    return false;
+  }
+  if (!isConvertible(*type, t_type)) {
+    llvm::errs() << "Expected " << getTypeName(t_type) << ", got "
+                 << getTypeName(*type) << ".\n";
+    return false;
+  }
+  return true;
+}
+
+bool TypeChecker::checkCondition(expressionRef t_condition) {
+  auto type = checkExpression(t_condition, ValueType::boolean);
+  if (!type) {
+    return false;
+  }
+  if (!isScalar(*type)) {
+    llvm::errs() << "Expected a condition, got " << getTypeName(*type) << ".\n";
+    return false;
+  }
+  return true;
+}
+
+bool TypeChecker::checkParallelFor(lineRef t_loop) {
+  // pfor let i = start; i < end; i += 1 { ... }
+  // where i is an integer, so the range can be split up before it starts
+  const Node &loop = m_tree.get(t_loop);
+  const Node &initialization = m_tree.get(loop.m_operands[0]);
+  const Node &condition = m_tree.get(loop.m_operands[1]);
+  const Node &updation = m_tree.get(loop.m_operands[2]);
+  if (initialization.m_kind != NodeKind::declaration ||
+      !initialization.m_operands[0].isValid() ||
+      !isInteger(initialization.m_type)) {
+    llvm::errs() << "A pfor loop has to start by declaring an integer index "
+                    "with a value.\n";
+    return false;
+  }
+  Symbol index = initialization.m_name;
+  if (condition.m_kind != NodeKind::binaryOp ||
+      condition.m_op != OpCode::lesser || !isInteger(condition.m_type) ||
+      m_tree.get(condition.m_operands[0]).m_kind != NodeKind::variable ||
+      m_tree.get(condition.m_operands[0]).m_name != index) {
+    llvm::errs() << "The condition of a pfor loop has to be 'index < end', "
+                    "where end is an integer.\n";
+    return false;
+  }
+  if (updation.m_kind != NodeKind::assignmentOp ||
+      updation.m_op != OpCode::plusEq || updation.m_name != index ||
+      m_tree.get(updation.m_operands[0]).m_kind != NodeKind::number ||
+      m_tree.get(updation.m_operands[0]).m_number != 1) {
+    llvm::errs() << "A pfor loop has to count up with 'index += 1'.\n";
+    return false;
+  }
+
+  // variables from outside the loop can only be read, or added to as a
+  // reduction, which can't be read in the loop since each thread only has
+  // part of it
+  // the lowering captures the same variables, since it uses the same body
+  LoopBody body = m_tree.getLoopBody(t_loop);
+  std::unordered_set<Symbol> reductions;
+  for (uint32_t id = body.m_first; id < body.m_end; ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    if (node.m_kind == NodeKind::returnLine) {
+      llvm::errs() << "Can't return from inside a pfor loop.\n";
+      return false;
+    }
+    if (node.m_kind != NodeKind::assignmentOp) {
+      continue;
+    }
+    if (node.m_name == index) {
+      llvm::errs() << "The index of a pfor loop can't be changed in it.\n";
+      return false;
+    }
+    if (body.m_locals.count(node.m_name)) {
+      continue;
+    }
+    if ((node.m_op != OpCode::plusEq && node.m_op != OpCode::minusEq) ||
+        !isNumeric(m_variables[node.m_name])) {
+      llvm::errs() << "A pfor loop can only change the number '"
+                   << symbols().getName(node.m_name)
+                   << "' from outside it with += or -=.\n";
+      return false;
+    }
+    reductions.insert(node.m_name);
+  }
+  for (uint32_t id = body.m_first; id < body.m_end; ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    if (node.m_kind == NodeKind::variable && reductions.count(node.m_name)) {
+      llvm::errs() << "'" << symbols().getName(node.m_name)
+                   << "' is added to in a pfor loop, so it can't be read "
+                      "there.\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TypeChecker::checkLine(lineRef t_line) {
+  Node &node = m_tree.get(t_line);
+  switch (node.m_kind) {
+  case NodeKind::conditional: {
+    for (expressionRef condition : m_tree.items(node.m_list)) {
+      if (!checkCondition(condition)) {
+        return false;
+      }
+    }
+    for (blockRef block : m_tree.items(node.m_blocks)) {
+      if (!checkBlock(block)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  case NodeKind::whileLoop:
+    return checkCondition(node.m_operands[0]) && checkBlock(node.m_list);
+  case NodeKind::forLoop:
+    return checkLine(node.m_operands[0]) &&
+           checkCondition(node.m_operands[1]) &&
+           checkLine(node.m_operands[2]) && checkBlock(node.m_list) &&
+           (!m_tree.hasAttribute(node.m_attributes, AttributeKind::parallel) ||
+            checkParallelFor(t_line));
+  case NodeKind::declaration: {
+    if (m_variables.count(node.m_name)) {
+      llvm::errs() << "Variable '" << symbols().getName(node.m_name)
+                   << "' already exists in this scope.\n";
+      return false;
+    }
+
+    // without an annotation, the variable has the type of its value
+    if (node.m_operands[0].isValid()) {
+      if (node.m_type == ValueType::unknown) {
+        auto type = checkExpression(node.m_operands[0], ValueType::unknown);
+        if (!type) {
+          return false;
+        }
+        if (*type == ValueType::none) {
+          llvm::errs() << "Expected a value for '"
+                       << symbols().getName(node.m_name) << "'.\n";
+          return false;
+        }
+        node.m_type = *type;
+      } else if (!checkValue(node.m_operands[0], node.m_type)) {
+        return false;
+      }
+    } else if (node.m_type == ValueType::unknown) {
+      node.m_type = ValueType::f64;
+    }
+    m_variables[node.m_name] = node.m_type;
+    if (m_tree.hasAttribute(node.m_attributes, AttributeKind::constant)) {
+      m_constants.insert(node.m_name);
+    }
+    return true;
+  }
+  case NodeKind::returnLine: {
+    if (!checkValue(node.m_operands[0], m_returnType)) {
+      return false;
+    }
+
+    // a call whose result is returned as it is can be a tail call
+    const Node &value = m_tree.get(node.m_operands[0]);
+    if (value.m_kind != NodeKind::call || value.m_type != m_returnType ||
+        getBuiltin(symbols().getName(value.m_name))) {
+      return true;
+    }
+    if (m_stackArrays) {
+      for (expressionRef arg : m_tree.items(value.m_list)) {
+        if (isArray(m_tree.get(arg).m_type)) {
+          return true;
+        }
+      }
+    }
+    node.m_attributes =
+        m_tree.makeList(std::vector<Attribute>{{AttributeKind::tailCall, 0}});
+    return true;
+  }
+  default:
+    return checkExpression(t_line, ValueType::unknown).has_value();
+  }
+}
+
+bool TypeChecker::checkBlock(blockRef t_block) {
+  for (lineRef line : m_tree.items(t_block)) {
+    if (!checkLine(line)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TypeChecker::checkTailRecursion(nodeRef t_function) {
+  const Node &function = m_tree.get(t_function);
+  Symbol name = m_tree.get(function.m_operands[0]).m_name;
+
+  // the values of return lines, and whether they are tail calls
+  std::unordered_map<uint32_t, bool> returned;
+  for (uint32_t id = function.m_first; id < t_function.getId(); ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    if (node.m_kind == NodeKind::returnLine) {
+      returned[node.m_operands[0].getId()] =
+          m_tree.hasAttribute(node.m_attributes, AttributeKind::tailCall);
+    }
+  }
+
+  bool recursive = false;
+  for (uint32_t id = function.m_first; id < t_function.getId(); ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    if (node.m_kind != NodeKind::call || node.m_name != name) {
+      continue;
+    }
+    recursive = true;
+    auto result = returned.find(id);
+    if (result == returned.end()) {
+      llvm::errs() << "'" << symbols().getName(name)
+                   << "' is @tailrec, but it uses the result of a call to "
+                      "itself instead of returning it.\n";
+      return false;
+    }
+    if (!result->second) {
+      llvm::errs() << "'" << symbols().getName(name)
+                   << "' is @tailrec, but it passes arrays to itself while "
+                      "it has fixed-size arrays.\n";
+      return false;
+    }
+  }
+  if (!recursive) {
+    llvm::errs() << "'" << symbols().getName(name)
+                 << "' is @tailrec, but it never calls itself.\n";
+    return false;
+  }
+  return true;
+}
+
+bool TypeChecker::checkFunction(nodeRef t_function) {
+  const Node &function = m_tree.get(t_function);
+  const Node &prototype = m_tree.get(function.m_operands[0]);
+  m_variables.clear();
+  m_constants.clear();
+  for (const Parameter &param : m_tree.items(prototype.m_params)) {
+    m_variables[param.m_name] = param.m_type;
+  }
+  m_returnType = prototype.m_type;
+  m_constFunction =
+      m_tree.hasAttribute(prototype.m_attributes, AttributeKind::constant);
+  m_stackArrays = false;
+  for (uint32_t id = function.m_first; id < t_function.getId(); ++id) {
+    const Node &node = m_tree.get(nodeRef(id));
+    if (node.m_kind == NodeKind::declaration && node.m_number) {
+      m_stackArrays = true;
+    }
+  }
+
+  if (!checkBlock(function.m_list)) {
+    return false;
+  }
+  return !m_tree.hasAttribute(prototype.m_attributes, AttributeKind::tailRec) ||
+         checkTailRecursion(t_function);
+}
+
+bool TypeChecker::check() {
+  for (auto &[name, prototype] : m_signatures) {
+    if (getBuiltin(symbols().getName(name))) {
+      llvm::errs() << "Can't define a function named '"
+                   << symbols().getName(name) << "', which is a builtin.\n";
+      return false;
+    }
+  }
+
+  for (nodeRef item : m_tree.getItems()) {
+    if (m_tree.get(item).m_kind == NodeKind::function && !checkFunction(item)) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,78 @@
+#ifndef BEAVER_TYPECHECKER_HPP
+#define BEAVER_TYPECHECKER_HPP
+
+#include "builtins.hpp"
+#include "syntaxtree.hpp"
+#include "types.hpp"
+#include "llvm/Support/raw_ostream.h"
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+// Decides the type of every expression and unannotated declaration, and
+// reports values that are used as the wrong type
+// Types flow from the context into number literals, so "i + 1" is an integer
+// addition if i is an integer, and a literal without context is an f64
+class TypeChecker {
+private:
+  SyntaxTree &m_tree;
+
+  // prototype of every function in the tree
+  std::unordered_map<Symbol, nodeRef> m_signatures;
+
+  // variables of the function being checked
+  std::unordered_map<Symbol, ValueType> m_variables;
+  // variables declared with const, which can't be changed
+  std::unordered_set<Symbol> m_constants;
+  ValueType m_returnType = ValueType::unknown;
+  // const fns can only call other const fns
+  bool m_constFunction = false;
+  // the function has fixed-size arrays, which are on its stack and can't be
+  // passed to a tail call
+  bool m_stackArrays = false;
+
+  // t_expected is the type the context wants, or unknown if it doesn't care
+  // returns nothing after reporting an error
+  std::optional<ValueType> checkExpression(expressionRef t_expression,
+                                           ValueType t_expected);
+  // the type two values are converted to, named t_name in errors
+  std::optional<ValueType> unify(std::string_view t_name, ValueType t_first,
+                                 ValueType t_second);
+  // check two operands that are converted to the same type, which is
+  // returned
+  std::optional<ValueType> checkOperands(std::string_view t_name,
+                                         expressionRef t_first,
+                                         expressionRef t_second,
+                                         ValueType t_expected);
+  std::optional<ValueType> checkBinaryOp(Node &t_node, ValueType t_expected);
+  // t_assigned is set if the element is assigned to
+  std::optional<ValueType> checkIndex(Node &t_node, bool t_assigned);
+  bool checkIndexValue(expressionRef t_index);
+  // an expression that has to be an array
+  std::optional<ValueType> checkArray(expressionRef t_expression);
+  // an array or vector whose elements are changed, which can't be a constant
+  bool checkChangeable(expressionRef t_expression);
+  std::optional<ValueType> checkBuiltin(Node &t_node, const BuiltinInfo &t_info,
+                                        ValueType t_expected);
+  std::optional<ValueType> checkCall(Node &t_node, ValueType t_expected);
+  // check that an expression is converted to t_type
+  bool checkValue(expressionRef t_expression, ValueType t_type);
+  // conditions can be booleans or numbers, which are true if they aren't 0
+  bool checkCondition(expressionRef t_condition);
+  // the shape of a pfor loop, and what its body can change
+  bool checkParallelFor(lineRef t_loop);
+  bool checkLine(lineRef t_line);
+  bool checkBlock(blockRef t_block);
+  // every call a @tailrec function makes to itself has to be a tail call
+  bool checkTailRecursion(nodeRef t_function);
+  bool checkFunction(nodeRef t_function);
+
+public:
+  TypeChecker(SyntaxTree &t_tree);
+
+  // check every top-level item, returns false if there were errors
+  bool check();
+};
+
+#endif // BEAVER_TYPECHECKER_HPP
@@ -0,0 +1,198 @@
+#ifndef BEAVER_TYPES_HPP
+#define BEAVER_TYPES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+// Types of Beaver values
+// unknown is only used before the type checker has run, and none is the type
+// of builtins that don't give a value, like free
+// Arrays are slices: a pointer to their elements and a length
+// Vectors are a fixed number of lanes that operators work on all at once,
+// and comparing vectors gives a vector of bools, which is a mask
+enum class ValueType : uint8_t {
+  unknown,
+  none,
+  boolean,
+  i32,
+  i64,
+  f64,
+  // arrays
+  i32Array,
+  i64Array,
+  f64Array,
+  // vectors
+  boolx2,
+  boolx4,
+  boolx8,
+  boolx16,
+  i32x4,
+  i32x8,
+  i32x16,
+  i64x2,
+  i64x4,
+  i64x8,
+  f64x2,
+  f64x4,
+  f64x8
+};
+
+namespace types {
+constexpr std::array<std::pair<std::string_view, ValueType>, 17> TypeNames = {
+    {{"bool", ValueType::boolean},
+     {"i32", ValueType::i32},
+     {"i64", ValueType::i64},
+     {"f64", ValueType::f64},
+     {"boolx2", ValueType::boolx2},
+     {"boolx4", ValueType::boolx4},
+     {"boolx8", ValueType::boolx8},
+     {"boolx16", ValueType::boolx16},
+     {"i32x4", ValueType::i32x4},
+     {"i32x8", ValueType::i32x8},
+     {"i32x16", ValueType::i32x16},
+     {"i64x2", ValueType::i64x2},
+     {"i64x4", ValueType::i64x4},
+     {"i64x8", ValueType::i64x8},
+     {"f64x2", ValueType::f64x2},
+     {"f64x4", ValueType::f64x4},
+     {"f64x8", ValueType::f64x8}}};
+
+// arrays of each element type, which are written as "[f64]"
+constexpr std::array<std::pair<ValueType, ValueType>, 3> ArrayTypes = {
+    {{ValueType::i32, ValueType::i32Array},
+     {ValueType::i64, ValueType::i64Array},
+     {ValueType::f64, ValueType::f64Array}}};
+constexpr std::array<std::string_view, 3> ArrayNames = {"[i32]", "[i64]",
+                                                        "[f64]"};
+
+struct VectorInfo {
+  ValueType type;
+  ValueType lane;
+  uint32_t lanes;
+};
+constexpr std::array<VectorInfo, 13> VectorTypes = {
+    {{ValueType::boolx2, ValueType::boolean, 2},
+     {ValueType::boolx4, ValueType::boolean, 4},
+     {ValueType::boolx8, ValueType::boolean, 8},
+     {ValueType::boolx16, ValueType::boolean, 16},
+     {ValueType::i32x4, ValueType::i32, 4},
+     {ValueType::i32x8, ValueType::i32, 8},
+     {ValueType::i32x16, ValueType::i32, 16},
+     {ValueType::i64x2, ValueType::i64, 2},
+     {ValueType::i64x4, ValueType::i64, 4},
+     {ValueType::i64x8, ValueType::i64, 8},
+     {ValueType::f64x2, ValueType::f64, 2},
+     {ValueType::f64x4, ValueType::f64, 4},
+     {ValueType::f64x8, ValueType::f64, 8}}};
+} // namespace types
+
+// the type with a name, if there is one
+inline std::optional<ValueType> getTypeFromName(std::string_view t_name) {
+  for (auto &[name, type] : types::TypeNames) {
+    if (name == t_name) {
+      return type;
+    }
+  }
+  return {};
+}
+
+inline std::string_view getTypeName(ValueType t_type) {
+  for (auto &[name, type] : types::TypeNames) {
+    if (type == t_type) {
+      return name;
+    }
+  }
+  for (size_t i = 0; i < types::ArrayTypes.size(); ++i) {
+    if (types::ArrayTypes[i].second == t_type) {
+      return types::ArrayNames[i];
+    }
+  }
+  return t_type == ValueType::none ? "none" : "unknown";
+}
+
+// the array of an element type, if it can be in arrays
+inline std::optional<ValueType> getArrayType(ValueType t_element) {
+  for (auto &[element, array] : types::ArrayTypes) {
+    if (element == t_element) {
+      return array;
+    }
+  }
+  return {};
+}
+
+// the element type of an array, or unknown if t_array isn't one
+inline ValueType getElementType(ValueType t_array) {
+  for (auto &[element, array] : types::ArrayTypes) {
+    if (array == t_array) {
+      return element;
+    }
+  }
+  return ValueType::unknown;
+}
+
+inline bool isArray(ValueType t_type) {
+  return getElementType(t_type) != ValueType::unknown;
+}
+
+// the vector with t_lanes lanes of a type, if there is one
+inline std::optional<ValueType> getVectorType(ValueType t_lane,
+                                              uint32_t t_lanes) {
+  for (const types::VectorInfo &info : types::VectorTypes) {
+    if (info.lane == t_lane && info.lanes == t_lanes) {
+      return info.type;
+    }
+  }
+  return {};
+}
+
+// the type of each lane of a vector, or unknown if t_vector isn't one
+inline ValueType getLaneType(ValueType t_vector) {
+  for (const types::VectorInfo &info : types::VectorTypes) {
+    if (info.type == t_vector) {
+      return info.lane;
+    }
+  }
+  return ValueType::unknown;
+}
+
+// number of lanes of a vector, or 0 if t_vector isn't one
+inline uint32_t getLaneCount(ValueType t_vector) {
+  for (const types::VectorInfo &info : types::VectorTypes) {
+    if (info.type == t_vector) {
+      return info.lanes;
+    }
+  }
+  return 0;
+}
+
+inline bool isVector(ValueType t_type) { return getLaneCount(t_type) != 0; }
+
+inline bool isInteger(ValueType t_type) {
+  return t_type == ValueType::i32 || t_type == ValueType::i64;
+}
+inline bool isNumeric(ValueType t_type) {
+  return isInteger(t_type) || t_type == ValueType::f64;
+}
+// values that operators and conditions work on
+inline bool isScalar(ValueType t_type) {
+  return isNumeric(t_type) || t_type == ValueType::boolean;
+}
+// vectors of numbers, which operators work on lane by lane
+inline bool isNumericVector(ValueType t_type) {
+  return isNumeric(getLaneType(t_type));
+}
+
+// Booleans can be used as numbers, where they are 0 or 1, so conditions can
+// be added up, and a value can be used as a vector of its type, where it's
+// in every lane
+// no other conversions are implicit
+inline bool isConvertible(ValueType t_from, ValueType t_to) {
+  return t_from == t_to || (t_from == ValueType::boolean && isNumeric(t_to)) ||
+         (isVector(t_to) && t_from == getLaneType(t_to));
+}
+
+#endif // BEAVER_TYPES_HPP